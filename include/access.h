@@ -34,20 +34,64 @@ struct CoreExport Privilege
 	Anope::string desc;
 	/* Rank relative to other privileges */
 	int rank;
+	/* Interned id of the name, see PrivilegeManager::GetID */
+	unsigned id;
 
 	Privilege(const Anope::string &name, const Anope::string &desc, int rank);
 	bool operator==(const Privilege &other) const;
 };
 
+/* A set of privileges, indexed by Privilege::id */
+class PrivilegeSet
+{
+	std::vector<bool> privs;
+ public:
+	inline void Set(unsigned id)
+	{
+		if (id >= privs.size())
+			privs.resize(id + 1);
+		privs[id] = true;
+	}
+
+	inline bool Has(unsigned id) const { return id < privs.size() && privs[id]; }
+
+	inline void Clear() { privs.clear(); }
+};
+
 class CoreExport PrivilegeManager
 {
 	static std::vector<Privilege> Privileges;
+	/* Positions in Privileges, indexed by privilege id */
+	static std::vector<int> Positions;
+	static unsigned Revision;
+
+	static void BuildPositions();
  public:
 	static void AddPrivilege(Privilege p);
 	static void RemovePrivilege(Privilege &p);
 	static Privilege *FindPrivilege(const Anope::string &name);
+	static Privilege *FindPrivilege(unsigned id);
 	static std::vector<Privilege> &GetPrivileges();
 	static void ClearPrivileges();
+
+	/** Get the id for a privilege name. Ids are dense, assigned the first
+	 * time a name is seen, and never reused, so they remain valid across
+	 * rehashes even though the privileges themselves are recreated.
+	 * @param name The privilege name
+	 * @return The id
+	 */
+	static unsigned GetID(const Anope::string &name);
+
+	/** Get the revision of the privileges. This changes whenever privileges
+	 * or anything access entries derive their privileges from changes, such
+	 * as channel levels.
+	 */
+	static unsigned GetRevision();
+
+	/** Invalidates the privileges computed by access entries, call when
+	 * something they are derived from changes.
+	 */
+	static void Invalidate();
 };
 
 /* A provider of access. Only used for creating ChanAccesses, as
@@ -76,6 +120,20 @@ class CoreExport ChanAccess : public Serializable
 	Anope::string mask;
 	/* account this access entry is for, if any */
 	Serialize::Reference<NickCore> nc;
+	/* privileges this entry has, if the provider can compute them */
+	mutable PrivilegeSet privileges;
+	/* revision of privileges, compared against PrivilegeManager::GetRevision */
+	mutable unsigned privileges_revision;
+	mutable bool privileges_known;
+
+ protected:
+	/** Compute every privilege this entry has, so that checking for
+	 * privileges by id does not need to go through HasPriv(name).
+	 * This is called again whenever PrivilegeManager::GetRevision changes.
+	 * @param privs Set to add the privileges to
+	 * @return false if privileges can not be determined this way
+	 */
+	virtual bool GetPrivileges(PrivilegeSet &privs) const;
 
  public:
 	typedef std::vector<ChanAccess *> Path;
@@ -112,6 +170,11 @@ class CoreExport ChanAccess : public Serializable
 	 */
 	virtual bool HasPriv(const Anope::string &name) const = 0;
 
+	/** Check if this access entry has the given privilege.
+	 * @param privid The privilege id
+	 */
+	bool HasPriv(unsigned privid) const;
+
 	/** Serialize the access given by this access entry into a human
 	 * readable form. chanserv/access will return a number, chanserv/xop
 	 * will be AOP, SOP, etc.
@@ -154,6 +217,7 @@ class CoreExport AccessGroup
 	 * @return true if any entry has the given privilege
 	 */
 	bool HasPriv(const Anope::string &priv) const;
+	bool HasPriv(unsigned id) const;
 
 	/** Get the "highest" access entry from this group of entries.
 	 * The highest entry is determined by the entry that has the privilege
@@ -19,10 +19,13 @@
 #include "base.h"
 
 typedef Anope::hash_map<NickAlias *> nickalias_map;
+typedef Anope::map<NickAlias *> nickalias_index;
 typedef Anope::hash_map<NickCore *> nickcore_map;
 typedef TR1NS::unordered_map<uint64_t, NickCore *> nickcoreid_map;
 
 extern CoreExport Serialize::Checker<nickalias_map> NickAliasList;
+/* NickAliasList sorted by nick */
+extern CoreExport Serialize::Checker<nickalias_index> NickAliasIndex;
 extern CoreExport Serialize::Checker<nickcore_map> NickCoreList;
 extern CoreExport nickcoreid_map NickCoreIdList;
 
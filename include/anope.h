@@ -311,12 +311,10 @@ namespace Anope
 	inline const string operator+(const char *_str, const string &str) { string tmp(_str); tmp += str; return tmp; }
 	inline const string operator+(const std::string &_str, const string &str) { string tmp(_str); tmp += str; return tmp; }
 
-	struct hash_ci
+	/* Hashes strings in a way that ignores case, without copying them */
+	struct CoreExport hash_ci
 	{
-		inline size_t operator()(const string &s) const
-		{
-			return TR1NS::hash<std::string>()(s.lower().str());
-		}
+		size_t operator()(const string &s) const;
 	};
 
 	struct hash_cs
@@ -331,7 +329,7 @@ namespace Anope
 	{
 		inline bool operator()(const string &s1, const string &s2) const
 		{
-			return s1.equals_ci(s2);
+			return s1.length() == s2.length() && !ci::ci_char_traits::compare(s1.c_str(), s2.c_str(), s1.length());
 		}
 	};
 
@@ -433,6 +431,14 @@ namespace Anope
 	 */
 	extern CoreExport bool Match(const string &str, const string &mask, bool case_sensitive = false, bool use_regex = false);
 
+	/** Get the part of a pattern before its first wildcard. Every string
+	 * matching the pattern starts with this, so it can be used to narrow
+	 * down a search of a sorted container.
+	 * @param mask The pattern
+	 * @return The prefix, which is empty if the pattern may be a regex
+	 */
+	extern CoreExport string GetMatchPrefix(const string &mask);
+
 	/** Converts a string to hex
 	 * @param the data to be converted
 	 * @return a anope::string containing the hex value
@@ -480,6 +486,14 @@ namespace Anope
 	 */
 	extern CoreExport uint64_t SipHash24(const void *src, unsigned long src_sz, const char key[16]);
 
+	/** Hashes a buffer with SipHash-2-4 as if each byte had first been replaced using a table
+	 * @param src The start of the buffer to hash
+	 * @param src_sz The total number of bytes in the buffer
+	 * @param key A 16 byte key to hash the buffer with.
+	 * @param map The replacement for each byte, eg. a case map
+	 */
+	extern CoreExport uint64_t SipHash24(const void *src, unsigned long src_sz, const char key[16], const unsigned char map[256]);
+
 	/** Returns a sequence of data formatted as the format argument specifies.
 	 ** After the format parameter, the function expects at least as many
 	 ** additional arguments as specified in format.
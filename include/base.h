@@ -15,10 +15,13 @@
  */
 class CoreExport Base
 {
-	/* References to this base class */
-	std::set<ReferenceBase *> *references;
+	/* The first of the references to this base class, which are linked together */
+	ReferenceBase *references;
  public:
 	Base();
+	/* References belong to the object they refer to and are never copied */
+	Base(const Base &);
+	Base &operator=(const Base &);
 	virtual ~Base();
 
 	/** Adds a reference to this object. Eg, when a Reference
@@ -32,11 +35,16 @@ class CoreExport Base
 
 class ReferenceBase
 {
+	friend class Base;
+
+	/* The other references to the object this refers to */
+	ReferenceBase *prev_reference, *next_reference;
+
  protected:
 	bool invalid;
  public:
-	ReferenceBase() : invalid(false) { }
-	ReferenceBase(const ReferenceBase &other) : invalid(other.invalid) { }
+	ReferenceBase() : prev_reference(NULL), next_reference(NULL), invalid(false) { }
+	ReferenceBase(const ReferenceBase &other) : prev_reference(NULL), next_reference(NULL), invalid(other.invalid) { }
 	virtual ~ReferenceBase() { }
 	inline void Invalidate() { this->invalid = true; }
 };
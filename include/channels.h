@@ -36,7 +36,10 @@ class CoreExport Channel : public Base, public Extensible
  public:
 	typedef std::multimap<Anope::string, Anope::string> ModeList;
  private:
-	/** A map of channel modes with their parameters set on this channel
+	/** Modes without parameters set on this channel, by mode char
+	 */
+	std::bitset<256> flag_modes;
+	/** A map of the other channel modes with their parameters set on this channel
 	 */
 	ModeList modes;
 
@@ -143,6 +146,13 @@ class CoreExport Channel : public Base, public Extensible
 	 */
 	size_t HasMode(const Anope::string &name, const Anope::string &param = "");
 
+	/** See if a channel has a mode
+	 * @param cm The mode
+	 * @param param The optional mode param
+	 * @return The number of modes set
+	 */
+	size_t HasMode(ChannelMode *cm, const Anope::string &param = "");
+
 	/** Set a mode internally on a channel, this is not sent out to the IRCd
 	 * @param setter The setter
 	 * @param cm The mode
@@ -239,7 +249,7 @@ class CoreExport Channel : public Base, public Extensible
 	/** Get all modes set on this channel, excluding status modes.
 	 * @return a map of modes and their optional parameters.
 	 */
-	const ModeList &GetModes() const;
+	ModeList GetModes() const;
 
 	/** Get a list of modes on a channel
 	 * @param name A mode name to get the list of
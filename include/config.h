@@ -109,8 +109,6 @@ namespace Configuration
 		bool DefPrivmsg;
 		/* Default language */
 		Anope::string DefLanguage;
-		/* options:timeoutcheck */
-		time_t TimeoutCheck;
 		/* options:usestrictprivmsg */
 		bool UseStrictPrivmsg;
 		/* networkinfo:nickchars */
@@ -191,4 +189,191 @@ class ConfigException : public CoreException
 extern Configuration::File ServicesConf;
 extern CoreExport Configuration::Conf *Config;
 
+namespace Configuration
+{
+	/** Settings from one configuration block which are parsed into a struct
+	 * whenever the configuration is loaded, rather than being looked up and
+	 * converted from strings each time they are used.
+	 */
+	class CoreExport SettingsBase
+	{
+		/* The name of the module or top level block the settings are in */
+		Anope::string block;
+		bool module;
+
+	 protected:
+		Block *GetBlock(Conf *conf) const;
+
+		template<typename V> static V Parse(Block *b, const Anope::string &name, const Anope::string &def)
+		{
+			const Anope::string &value = b->Get<const Anope::string>(name, def);
+			if (value.empty())
+				return V();
+
+			try
+			{
+				return convertTo<V>(value);
+			}
+			catch (const ConvertException &)
+			{
+				throw ConfigException("The value for <" + b->GetName() + ":" + name + "> is invalid: " + value);
+			}
+		}
+
+	 public:
+		/** Constructor for the settings in a module's block
+		 */
+		SettingsBase(Module *m);
+
+		/** Constructor
+		 * @param b The name of the block, such as options
+		 * @param m true if b is the name of a module whose block should be used
+		 */
+		SettingsBase(const Anope::string &b, bool m);
+
+		virtual ~SettingsBase();
+
+		/** Parses the settings from a configuration, without making them current yet
+		 * @throws ConfigException if a setting is invalid
+		 */
+		virtual void Prepare(Conf *conf) = 0;
+
+		/** Makes the settings prepared last current
+		 */
+		virtual void Commit() = 0;
+
+		/** Parses every registered set of settings from a configuration which is being loaded
+		 * @throws ConfigException if a setting is invalid
+		 */
+		static void PrepareAll(Conf *conf);
+
+		/** Makes every set of settings prepared by PrepareAll current, once the
+		 * configuration they came from has been fully validated
+		 */
+		static void CommitAll();
+	};
+
+	template<> inline const Anope::string SettingsBase::Parse(Block *b, const Anope::string &name, const Anope::string &def)
+	{
+		return b->Get<const Anope::string>(name, def);
+	}
+
+	template<> inline Anope::string SettingsBase::Parse(Block *b, const Anope::string &name, const Anope::string &def)
+	{
+		return b->Get<const Anope::string>(name, def);
+	}
+
+	template<> inline time_t SettingsBase::Parse(Block *b, const Anope::string &name, const Anope::string &def)
+	{
+		return b->Get<time_t>(name, def);
+	}
+
+	template<> inline bool SettingsBase::Parse(Block *b, const Anope::string &name, const Anope::string &def)
+	{
+		return b->Get<bool>(name, def);
+	}
+
+	/** Typed settings. Fields of T are bound to configuration items once, eg:
+	 *
+	 *   struct MySettings { time_t expire; bool enabled; };
+	 *   Configuration::Settings<MySettings> settings(this);
+	 *   settings.Bind(&MySettings::expire, "expire", "30d");
+	 *
+	 * and are then read with settings->expire. Reloading the configuration replaces
+	 * the whole struct, so a reader never sees a mix of old and new values.
+	 */
+	template<typename T> class Settings : public SettingsBase
+	{
+		class FieldBase
+		{
+		 public:
+			virtual ~FieldBase() { }
+			virtual void Load(T &t, Block *b) const = 0;
+		};
+
+		template<typename V> class Field : public FieldBase
+		{
+			V T::*member;
+			Anope::string name, def;
+
+		 public:
+			Field(V T::*m, const Anope::string &n, const Anope::string &d) : member(m), name(n), def(d) { }
+
+			void Load(T &t, Block *b) const anope_override
+			{
+				t.*member = Parse<V>(b, name, def);
+			}
+		};
+
+		std::vector<FieldBase *> fields;
+		T *current, *pending;
+
+	 public:
+		Settings(Module *m) : SettingsBase(m), current(new T()), pending(NULL) { }
+
+		Settings(const Anope::string &b, bool m = false) : SettingsBase(b, m), current(new T()), pending(NULL) { }
+
+		~Settings()
+		{
+			for (unsigned i = 0; i < fields.size(); ++i)
+				delete fields[i];
+			delete current;
+			delete pending;
+		}
+
+		/** Binds a field to a configuration item. If the configuration is already
+		 * loaded the field is read from it now.
+		 * @param member The field
+		 * @param name The name of the item
+		 * @param def The default value of the item
+		 * @throws ConfigException if the item is invalid
+		 */
+		template<typename V> void Bind(V T::*member, const Anope::string &name, const Anope::string &def)
+		{
+			FieldBase *f = new Field<V>(member, name, def);
+			fields.push_back(f);
+			if (Config)
+				f->Load(*current, this->GetBlock(Config));
+		}
+
+		template<typename V> void Bind(V T::*member, const Anope::string &name)
+		{
+			this->Bind(member, name, "");
+		}
+
+		void Prepare(Conf *conf) anope_override
+		{
+			delete pending;
+			pending = NULL;
+
+			T *t = new T();
+			try
+			{
+				Block *b = this->GetBlock(conf);
+				for (unsigned i = 0; i < fields.size(); ++i)
+					fields[i]->Load(*t, b);
+			}
+			catch (...)
+			{
+				delete t;
+				throw;
+			}
+			pending = t;
+		}
+
+		void Commit() anope_override
+		{
+			if (pending)
+			{
+				std::swap(current, pending);
+				delete pending;
+				pending = NULL;
+			}
+		}
+
+		const T *operator->() const { return current; }
+		const T &operator*() const { return *current; }
+	};
+}
+
 #endif // CONFIG_H
@@ -18,25 +18,78 @@ class Extensible;
 
 class CoreExport ExtensibleBase : public Service
 {
- protected:
-	std::map<Extensible *, void *> items;
+	friend class Extensible;
+
+	/* Index of this item in the extensions of objects, unique among the items which exist */
+	unsigned slot;
 
+ protected:
 	ExtensibleBase(Module *m, const Anope::string &n);
 	~ExtensibleBase();
 
+	/** Checks whether this item is set on an object
+	 * @param obj The object
+	 * @return true if the item is set
+	 */
+	inline bool IsSet(const Extensible *obj) const;
+
+	/** Gets the value of this item on an object
+	 * @param obj The object
+	 * @return The value, or NULL if the item is not set
+	 */
+	inline void *GetValue(const Extensible *obj) const;
+
+	/** Sets the value of this item on an object, which must not already have it set
+	 * @param obj The object
+	 * @param value The value
+	 */
+	void SetValue(Extensible *obj, void *value);
+
+	/** Removes this item from an object
+	 * @param obj The object
+	 * @return The value the item had, which the caller is responsible for deleting
+	 */
+	void *UnsetValue(Extensible *obj);
+
+	/** Unsets this item on every object it is set on. Called by derived classes
+	 * when they are destroyed, as only they know how to delete their values.
+	 */
+	void UnsetAll();
+
  public:
 	virtual void Unset(Extensible *obj) = 0;
 
 	/* called when an object we are keep track of is serializing */
 	virtual void ExtensibleSerialize(const Extensible *, const Serializable *, Serialize::Data &) const { }
 	virtual void ExtensibleUnserialize(Extensible *, Serializable *, Serialize::Data &) { }
+
+	/** Finds an extension item by name
+	 * @param name The name of the item
+	 * @return The item, or NULL if there is no item with that name
+	 */
+	static ExtensibleBase *Find(const Anope::string &name);
 };
 
 class CoreExport Extensible
 {
- public:
-	std::set<ExtensibleBase *> extension_items;
+	friend class ExtensibleBase;
+
+	struct Extension
+	{
+		unsigned slot;
+		void *value;
+	};
+
+	/* The items set on this object, ordered by slot */
+	std::vector<Extension> extensions;
+	/* Objects with extensions are linked together so items can be removed from all of them */
+	Extensible *prev_extended, *next_extended;
 
+ public:
+	Extensible();
+	/* Extensions belong to the object they were set on and are never copied */
+	Extensible(const Extensible &);
+	Extensible &operator=(const Extensible &);
 	virtual ~Extensible();
 
 	void UnsetExtensibles();
@@ -53,6 +106,22 @@ class CoreExport Extensible
 	static void ExtensibleUnserialize(Extensible *, Serializable *, Serialize::Data &data);
 };
 
+inline bool ExtensibleBase::IsSet(const Extensible *obj) const
+{
+	for (std::vector<Extensible::Extension>::const_iterator it = obj->extensions.begin(), it_end = obj->extensions.end(); it != it_end && it->slot <= this->slot; ++it)
+		if (it->slot == this->slot)
+			return true;
+	return false;
+}
+
+inline void *ExtensibleBase::GetValue(const Extensible *obj) const
+{
+	for (std::vector<Extensible::Extension>::const_iterator it = obj->extensions.begin(), it_end = obj->extensions.end(); it != it_end && it->slot <= this->slot; ++it)
+		if (it->slot == this->slot)
+			return it->value;
+	return NULL;
+}
+
 template<typename T>
 class BaseExtensibleItem : public ExtensibleBase
 {
@@ -64,16 +133,7 @@ class BaseExtensibleItem : public ExtensibleBase
 
 	~BaseExtensibleItem()
 	{
-		while (!items.empty())
-		{
-			std::map<Extensible *, void *>::iterator it = items.begin();
-			Extensible *obj = it->first;
-			T *value = static_cast<T *>(it->second);
-
-			obj->extension_items.erase(this);
-			items.erase(it);
-			delete value;
-		}
+		this->UnsetAll();
 	}
 
 	T* Set(Extensible *obj, const T &value)
@@ -88,30 +148,23 @@ class BaseExtensibleItem : public ExtensibleBase
 	{
 		T* t = Create(obj);
 		Unset(obj);
-		items[obj] = t;
-		obj->extension_items.insert(this);
+		this->SetValue(obj, t);
 		return t;
 	}
 
 	void Unset(Extensible *obj) anope_override
 	{
-		T *value = Get(obj);
-		items.erase(obj);
-		obj->extension_items.erase(this);
-		delete value;
+		delete static_cast<T *>(this->UnsetValue(obj));
 	}
 
 	T* Get(const Extensible *obj) const
 	{
-		std::map<Extensible *, void *>::const_iterator it = items.find(const_cast<Extensible *>(obj));
-		if (it != items.end())
-			return static_cast<T *>(it->second);
-		return NULL;
+		return static_cast<T *>(this->GetValue(obj));
 	}
 
 	bool HasExt(const Extensible *obj) const
 	{
-		return items.find(const_cast<Extensible *>(obj)) != items.end();
+		return this->IsSet(obj);
 	}
 
 	T* Require(Extensible *obj)
@@ -213,9 +266,9 @@ struct ExtensibleRef : ServiceReference<BaseExtensibleItem<T> >
 template<typename T>
 T* Extensible::GetExt(const Anope::string &name) const
 {
-	ExtensibleRef<T> ref(name);
-	if (ref)
-		return ref->Get(this);
+	BaseExtensibleItem<T> *item = static_cast<BaseExtensibleItem<T> *>(ExtensibleBase::Find(name));
+	if (item)
+		return item->Get(this);
 
 	Log(LOG_DEBUG) << "GetExt for nonexistent type " << name << " on " << static_cast<const void *>(this);
 	return NULL;
@@ -233,9 +286,9 @@ T* Extensible::Extend(const Anope::string &name, const T &what)
 template<typename T>
 T* Extensible::Extend(const Anope::string &name)
 {
-	ExtensibleRef<T> ref(name);
-	if (ref)
-		return ref->Set(this);
+	BaseExtensibleItem<T> *item = static_cast<BaseExtensibleItem<T> *>(ExtensibleBase::Find(name));
+	if (item)
+		return item->Set(this);
 
 	Log(LOG_DEBUG) << "Extend for nonexistent type " << name << " on " << static_cast<void *>(this);
 	return NULL;
@@ -253,9 +306,9 @@ T* Extensible::Require(const Anope::string &name)
 template<typename T>
 void Extensible::Shrink(const Anope::string &name)
 {
-	ExtensibleRef<T> ref(name);
-	if (ref)
-		ref->Unset(this);
+	ExtensibleBase *item = ExtensibleBase::Find(name);
+	if (item)
+		item->Unset(this);
 	else
 		Log(LOG_DEBUG) << "Shrink for nonexistent type " << name << " on " << static_cast<void *>(this);
 }
@@ -33,6 +33,12 @@ namespace Language
 	 */
 	extern void InitLanguages();
 
+	/** Loads the catalogs of every language and domain from their .mo files,
+	 * replacing the ones previously loaded. Strings returned by Translate
+	 * before this is called must not be used after it.
+	 */
+	extern void LoadCatalogs();
+
 	/** Translates a string to the default language.
 	 * @param string A string to translate
 	 * @return The translated string if found, else the original string.
@@ -66,5 +66,12 @@ struct BadWords
 	 */
 	virtual void ClearBadWords() = 0;
 
+	/** Find the first badword on the list which matches a message
+	 * @param message The message, which should already be normalized
+	 * @param casesensitive Whether or not to match case sensitively
+	 * @return The badword, or NULL if none match
+	 */
+	virtual BadWord* MatchBadWord(const Anope::string &message, bool casesensitive) = 0;
+
 	virtual void Check() = 0;
 };
@@ -13,6 +13,7 @@ enum HTTPError
 {
 	HTTP_ERROR_OK = 200,
 	HTTP_FOUND = 302,
+	HTTP_NOT_MODIFIED = 304,
 	HTTP_BAD_REQUEST = 400,
 	HTTP_PAGE_NOT_FOUND = 404,
 	HTTP_NOT_SUPPORTED = 505
@@ -133,6 +134,14 @@ class HTTPClient : public ClientSocket, public BinarySocket, public Base
 
 	virtual void SendError(HTTPError err, const Anope::string &msg) = 0;
 	virtual void SendReply(HTTPReply *) = 0;
+
+	/** Sends what has been written to a reply so far and clears it, so large
+	 * replies can be streamed instead of being built in memory. The first call
+	 * sends the headers, so they must be set before it. The reply is finished
+	 * by SendReply as usual.
+	 * @param The reply being streamed
+	 */
+	virtual void Flush(HTTPReply *) = 0;
 };
 
 class HTTPProvider : public ListenSocket, public Service
@@ -98,14 +98,21 @@ namespace SQL
 	{
 		Anope::string query;
 		std::map<Anope::string, QueryData> parameters;
+		/* A stable name for the shape of this query. If set, providers may prepare
+		 * the query once and reuse it, binding the escaped parameters natively
+		 * instead of escaping them into the query text.
+		 */
+		Anope::string key;
 
 		Query() { }
 		Query(const Anope::string &q) : query(q) { }
+		Query(const Anope::string &q, const Anope::string &k) : query(q), key(k) { }
 
 		Query& operator=(const Anope::string &q)
 		{
 			this->query = q;
 			this->parameters.clear();
+			this->key.clear();
 			return *this;
 		}
 
@@ -119,16 +126,64 @@ namespace SQL
 			return !(*this == other);
 		}
 
-		template<typename T> void SetValue(const Anope::string &key, const T& value, bool escape = true)
+		template<typename T> void SetValue(const Anope::string &param, const T& value, bool escape = true)
 		{
 			try
 			{
 				Anope::string string_value = stringify(value);
-				this->parameters[key].data = string_value;
-				this->parameters[key].escape = escape;
+				this->parameters[param].data = string_value;
+				this->parameters[param].escape = escape;
 			}
 			catch (const ConvertException &ex) { }
 		}
+
+		/** Builds the text of this query for preparing it. Escaped parameters are
+		 * replaced with placeholders, other parameters are substituted into the text.
+		 * @param text Set to the query text
+		 * @param values Set to the value of each placeholder, in order. Unescaped NULL
+		 * parameters also get a placeholder, with a NULL value, so that they are bound
+		 * as SQL NULL rather than changing the text of the query.
+		 */
+		void Prepare(Anope::string &text, std::vector<const Anope::string *> &values) const
+		{
+			text.clear();
+			values.clear();
+
+			size_t pos = 0;
+			for (size_t start; (start = this->query.find('@', pos)) != Anope::string::npos;)
+			{
+				size_t end = this->query.find('@', start + 1);
+				if (end == Anope::string::npos)
+					break;
+
+				std::map<Anope::string, QueryData>::const_iterator it = this->parameters.find(this->query.substr(start + 1, end - start - 1));
+				if (it == this->parameters.end())
+				{
+					/* Not a parameter, but the second @ may start one */
+					text += this->query.substr(pos, end - pos);
+					pos = end;
+					continue;
+				}
+
+				text += this->query.substr(pos, start - pos);
+				if (it->second.escape)
+				{
+					text += "?";
+					values.push_back(&it->second.data);
+				}
+				else if (it->second.data == "NULL")
+				{
+					text += "?";
+					values.push_back(NULL);
+				}
+				else
+					text += it->second.data;
+
+				pos = end + 1;
+			}
+
+			text += this->query.substr(pos);
+		}
 	};
 
 	/** A result from a SQL query
@@ -208,6 +263,12 @@ namespace SQL
 
 		virtual Query BuildInsert(const Anope::string &table, unsigned int id, Data &data) = 0;
 
+		/** Builds a single query inserting or updating several existing rows.
+		 * @param table The table
+		 * @param rows The data for each row, keyed by id. Columns missing from a row are emptied.
+		 */
+		virtual Query BuildInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows) = 0;
+
 		virtual Query GetTables(const Anope::string &prefix) = 0;
 
 		virtual Anope::string FromUnixtime(time_t) = 0;
@@ -16,10 +16,14 @@
 #include "modules.h"
 #include "serialize.h"
 #include "bots.h"
+#include "access.h"
 
 typedef Anope::hash_map<ChannelInfo *> registered_channel_map;
+typedef Anope::map<ChannelInfo *> registered_channel_index;
 
 extern CoreExport Serialize::Checker<registered_channel_map> RegisteredChannelList;
+/* RegisteredChannelList sorted by name */
+extern CoreExport Serialize::Checker<registered_channel_index> RegisteredChannelIndex;
 
 /* AutoKick data. */
 class CoreExport AutoKick : public Serializable
@@ -54,6 +58,12 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	Serialize::Checker<std::vector<ChanAccess *> > access;			/* List of authorized users */
 	Serialize::Checker<std::vector<AutoKick *> > akick;			/* List of users to kickban */
 	Anope::map<int16_t> levels;
+	/* levels indexed by privilege id */
+	std::vector<int16_t> level_ids;
+	/* Access entries matched by users, keyed by User::GetAccessGeneration */
+	std::map<uint64_t, std::vector<ChanAccess::Path> > access_cache;
+	/* Which generation of access entries access_cache is for */
+	uint64_t access_cache_generation;
 
  public:
 	friend class ChanAccess;
@@ -135,6 +145,18 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	AccessGroup AccessFor(const User *u, bool updateLastUsed = true);
 	AccessGroup AccessFor(const NickCore *nc, bool updateLastUsed = true);
 
+	/** Forget the access entries AccessFor has found users to match on every channel.
+	 * This must be called whenever anything that affects which users match which access
+	 * entries changes, other than the users themselves (see User::GetAccessGeneration).
+	 */
+	static void ClearAccessCache();
+
+	/** Get statistics about the cache used by AccessFor
+	 * @param hits Set to the number of times a user's access was found in the cache
+	 * @param misses Set to the number of times a user's access had to be looked up
+	 */
+	static void GetAccessCacheStats(unsigned long &hits, unsigned long &misses);
+
 	/** Get the size of the access vector for this channel
 	 * @return The access vector size
 	 */
@@ -208,6 +230,7 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	 * @throws CoreException if priv is not a valid privilege
 	 */
 	int16_t GetLevel(const Anope::string &priv) const;
+	int16_t GetLevel(unsigned privid) const;
 
 	/** Set the level for a privilege
 	 * @param priv The privilege priv
@@ -35,10 +35,29 @@ class CoreExport Regex
 	virtual bool Matches(const Anope::string &str) = 0;
 };
 
+class RegexProvider;
+
+namespace Anope
+{
+	/** Removes compiled expressions from the cache used by Anope::Match.
+	 * @param provider If set, only remove expressions compiled by this provider
+	 */
+	extern CoreExport void ClearRegexCache(RegexProvider *provider = NULL);
+
+	/** Gets statistics about the cache used by Anope::Match.
+	 * @param entries Set to the number of cached expressions
+	 * @param hits Set to the number of times a compiled expression was found in the cache
+	 * @param misses Set to the number of times an expression had to be compiled
+	 */
+	extern CoreExport void GetRegexCacheStats(size_t &entries, unsigned long &hits, unsigned long &misses);
+}
+
 class CoreExport RegexProvider : public Service
 {
  public:
 	RegexProvider(Module *o, const Anope::string &n) : Service(o, "Regex", n) { }
+	/* Expressions compiled by this provider can not outlive it */
+	virtual ~RegexProvider() { Anope::ClearRegexCache(this); }
 	virtual Regex *Compile(const Anope::string &) = 0;
 };
 
@@ -189,6 +189,12 @@ class Serialize::Checker
 	T obj;
 	mutable ::Reference<Serialize::Type> type;
 
+ public:
+	Checker(const Anope::string &n) : name(n), type(NULL) { }
+
+	/** Checks the type for updates without accessing the object, for callers
+	 * which cache things derived from it
+	 */
 	inline void Check() const
 	{
 		if (!type)
@@ -197,9 +203,6 @@ class Serialize::Checker
 			type->Check();
 	}
 
- public:
-	Checker(const Anope::string &n) : name(n), type(NULL) { }
-
 	inline const T* operator->() const
 	{
 		this->Check();
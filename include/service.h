@@ -134,6 +134,8 @@ class ServiceReference : public Reference<T>
 
 	inline void operator=(const Anope::string &n)
 	{
+		if (this->ref && !this->invalid)
+			this->ref->DelReference(this);
 		this->name = n;
 		this->invalid = true;
 	}
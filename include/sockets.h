@@ -281,6 +281,10 @@ class CoreExport BufferedSocket : public virtual Socket
 	Anope::string read_buffer;
 	/* Things to be written to the socket */
 	Anope::string write_buffer;
+	/* How much of read_buffer has already been returned by GetLine */
+	size_t read_offset;
+	/* How much of write_buffer has already been sent */
+	size_t write_offset;
 	/* How much data was received from this socket on this recv() */
 	int recv_len;
 
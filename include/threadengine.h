@@ -117,4 +117,74 @@ class CoreExport Condition : public Mutex
 	void Wait();
 };
 
+/** A unit of work which is run in a thread of the WorkerPool, such
+ * as hashing a password. Tasks are deleted by the pool once completed.
+ */
+class CoreExport Task
+{
+ public:
+	/* Module which queued this task. Tasks are discarded if their owner is unloaded */
+	Module *owner;
+
+	Task(Module *o) : owner(o) { }
+
+	virtual ~Task() { }
+
+	/** Called from a worker thread. This must only use data held by the task
+	 * itself, nothing else (logging, config, accounts etc) is thread safe.
+	 */
+	virtual void Run() = 0;
+
+	/** Called from the main thread after Run has finished
+	 */
+	virtual void OnComplete() = 0;
+};
+
+/** A pool of threads used to run Tasks which would otherwise block the
+ * main thread. Finished tasks are passed back to the main thread through a pipe.
+ */
+class CoreExport WorkerPool : public Pipe, public Condition
+{
+	class Worker;
+	friend class Worker;
+
+	/* Tasks waiting for a worker */
+	std::deque<Task *> pending;
+	/* Tasks which have been run but not yet completed */
+	std::deque<Task *> finished;
+	std::vector<Worker *> workers;
+	/* Set when the workers should exit */
+	bool exiting;
+
+	static WorkerPool *pool;
+
+	WorkerPool(unsigned threads);
+
+	/** Called from a worker thread to wait for and run tasks until told to exit
+	 */
+	void Work(Worker *w);
+
+ public:
+	~WorkerPool();
+
+	bool ProcessRead() anope_override;
+
+	void OnNotify() anope_override;
+
+	/** Queues a task to be run by the pool, creating the pool if necessary
+	 * @param t The task, which is owned by the pool from now on
+	 */
+	static void Queue(Task *t);
+
+	/** Discards every task owned by the given module, waiting for any currently
+	 * running task of it to finish first. OnComplete is not called for them.
+	 * @param m The module
+	 */
+	static void ModuleUnload(Module *m);
+
+	/** Stops every worker and deletes the pool. Tasks not yet completed are discarded
+	 */
+	static void Shutdown();
+};
+
 #endif // THREADENGINE_H
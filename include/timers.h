@@ -37,6 +37,21 @@ class CoreExport Timer
 	 */
 	bool repeat;
 
+	/** The triggering time on TimerManager's clock, in milliseconds
+	 */
+	uint64_t deadline;
+
+	/** The level and slot of the timer wheel this is in, level is -1 if it isn't in the wheel
+	 */
+	int level;
+	unsigned slot;
+
+	/** Where this is in its slot
+	 */
+	std::list<Timer *>::iterator pos;
+
+	friend class TimerManager;
+
  public:
 	/** Constructor, initializes the triggering time
 	 * @param time_from_now The number of seconds from now to trigger the timer
@@ -101,13 +116,51 @@ class CoreExport Timer
 /** This class manages sets of Timers, and triggers them at their defined times.
  * This will ensure timers are not missed, as well as removing timers that have
  * expired and allowing the addition of new ones.
+ *
+ * Timers are kept in a hierarchical timing wheel driven by a monotonic millisecond
+ * clock, so changes to the system time don't affect when they trigger. Each level
+ * of the wheel has Slots slots, and each slot of a level covers as much time as the
+ * whole level below it, starting with one millisecond per slot on level 0.
  */
 class CoreExport TimerManager
 {
-	/** A list of timers
+	static const int Levels = 5;
+	static const int SlotBits = 6;
+	static const int Slots = 1 << SlotBits;
+
+	/** The timer wheel
+	 */
+	static std::list<Timer *> Wheel[Levels][Slots];
+
+	/** The number of timers on each level of the wheel
 	 */
-	static std::multimap<time_t, Timer *> Timers;
+	static unsigned Counts[Levels];
+
+	/** The next millisecond of the wheel to be processed
+	 */
+	static uint64_t WheelTime;
+
+	/** Place a timer in the wheel based on its deadline
+	 * @param t The timer
+	 */
+	static void Schedule(Timer *t);
+
+	/** Move the timers in the current slot of a level down the wheel
+	 * @param level The level
+	 */
+	static void Cascade(int level);
  public:
+	/** Get the time used to schedule timers
+	 * @return The number of milliseconds since an arbitrary point, which never goes backwards
+	 */
+	static uint64_t GetTime();
+
+	/** Get how long it is until the next timer may need to be ticked
+	 * @param max The most to return
+	 * @return The number of milliseconds, which is never more than max
+	 */
+	static long GetTimeout(long max);
+
 	/** Add a timer to the list
 	 * @param t A Timer derived class to add
 	 */
@@ -21,8 +21,11 @@
 #include "sockets.h"
 
 typedef Anope::hash_map<User *> user_map;
+typedef Anope::map<User *> user_index;
 
 extern CoreExport user_map UserListByNick, UserListByUID;
+/* UserListByNick sorted by nick */
+extern CoreExport user_index UserIndexByNick;
 
 extern CoreExport int OperCount;
 extern CoreExport unsigned MaxUserCount;
@@ -44,11 +47,16 @@ class CoreExport User : public virtual Base, public Extensible, public CommandRe
 	Anope::string uid;
 	/* If the user is on the access list of the nick they're on */
 	bool on_access;
-	/* Map of user modes and the params this user has (if any) */
+	/* User modes without parameters this user has, by mode char */
+	std::bitset<256> flag_modes;
+	/* Map of the other user modes and the params this user has */
 	ModeList modes;
 	/* NickCore account the user is currently logged in as, if they are logged in */
 	Serialize::Reference<NickCore> nc;
 
+	/* Changed whenever something that affects which channel access entries this user matches changes */
+	uint64_t access_generation;
+
 	/* # of invalid password attempts */
 	unsigned short invalid_pw_count;
 	/* Time of last invalid password */
@@ -247,12 +255,25 @@ class CoreExport User : public virtual Base, public Extensible, public CommandRe
 	 */
 	void UpdateHost();
 
+	/** Get a number which changes whenever the user's nick, ident, displayed host or
+	 * account changes. No two users ever have the same number, so it can be used to
+	 * cache things which depend on these, such as channel access.
+	 * @return The number
+	 */
+	uint64_t GetAccessGeneration() const;
+
 	/** Check if the user has a mode
 	 * @param name Mode name
 	 * @return true or false
 	 */
 	bool HasMode(const Anope::string &name) const;
 
+	/** Check if the user has a mode
+	 * @param um The mode
+	 * @return true or false
+	 */
+	bool HasMode(UserMode *um) const;
+
 	/** Set a mode internally on the user, the IRCd is not informed
 	 * @param setter who/what is setting the mode
 	 * @param um The user mode
@@ -311,7 +332,7 @@ class CoreExport User : public virtual Base, public Extensible, public CommandRe
 	 */
 	Anope::string GetModes() const;
 
-	const ModeList &GetModeList() const;
+	ModeList GetModeList() const;
 
 	/** Find the channel container for Channel c that the user is on
 	 * This is preferred over using FindUser in Channel, as there are usually more users in a channel
@@ -48,12 +48,16 @@ class CoreExport XLine : public Serializable
 	static Serializable* Unserialize(Serializable *obj, Serialize::Data &data);
 };
 
+class XLineIndex;
+
 /* Managers XLines. There is one XLineManager per type of XLine. */
 class CoreExport XLineManager : public Service
 {
 	char type;
 	/* List of XLines in this XLineManager */
 	Serialize::Checker<std::vector<XLine *> > xlines;
+	/* Index of the hosts of the XLines in this XLineManager, used by CheckAllXLines */
+	XLineIndex *host_index;
 	/* Akills can have the same IDs, sometimes */
 	static Serialize::Checker<std::multimap<Anope::string, XLine *, ci::less> > XLinesByUID;
  public:
@@ -152,6 +156,13 @@ class CoreExport XLineManager : public Service
 	 */
 	XLine *CheckAllXLines(User *u);
 
+	/** Whether or not a user can only match an xline in this XLineManager if their host
+	 * or IP matches the host of the xline. If so, CheckAllXLines only checks the user
+	 * against the xlines found by looking up their host and IP in an index.
+	 * @return true if the hosts of the xlines can be indexed
+	 */
+	virtual bool IsHostIndexed() const;
+
 	/** Check a user against an xline
 	 * @param u The user
 	 * @param x The xline
@@ -27,11 +27,180 @@ struct BadWordImpl : BadWord, Serializable
 	static Serializable* Unserialize(Serializable *obj, Serialize::Data &);
 };
 
+/** An Aho-Corasick automaton of a list of badwords, which finds every occurrence
+ * of every badword in a message in one pass over the message.
+ */
+class BadWordMatcher
+{
+	struct State
+	{
+		std::map<unsigned char, unsigned> next;
+		/* The state for the longest proper suffix of this state which is also a prefix of a word */
+		unsigned fail;
+		/* The nearest state along the fail chain which ends a word, or 0 */
+		unsigned output;
+		/* The indexes of the words which end in this state */
+		std::vector<unsigned> words;
+
+		State() : fail(0), output(0) { }
+	};
+
+	std::vector<State> states;
+	/* The length and type of each word */
+	std::vector<std::pair<size_t, BadWordType> > words;
+	bool casesensitive;
+	bool built;
+
+	unsigned char Fold(char c) const
+	{
+		return this->casesensitive ? c : Anope::toupper(c);
+	}
+
+	unsigned Next(unsigned state, unsigned char c) const
+	{
+		for (;;)
+		{
+			std::map<unsigned char, unsigned>::const_iterator it = this->states[state].next.find(c);
+			if (it != this->states[state].next.end())
+				return it->second;
+			if (!state)
+				return 0;
+			state = this->states[state].fail;
+		}
+	}
+
+ public:
+	BadWordMatcher() : casesensitive(false), built(false) { }
+
+	void Clear()
+	{
+		this->states.clear();
+		this->words.clear();
+		this->built = false;
+	}
+
+	/** Check whether the matcher can be used
+	 * @param cs Whether or not matching should be case sensitive
+	 * @return true if the matcher has been built since its words last changed, with the same case sensitivity
+	 */
+	bool IsBuilt(bool cs) const
+	{
+		return this->built && this->casesensitive == cs;
+	}
+
+	void Build(const std::vector<BadWordImpl *> &badwords, bool cs)
+	{
+		this->Clear();
+		this->casesensitive = cs;
+		this->states.push_back(State());
+
+		for (unsigned i = 0; i < badwords.size(); ++i)
+		{
+			const BadWord *bw = badwords[i];
+			this->words.push_back(std::make_pair(bw->word.length(), bw->type));
+			if (bw->word.empty())
+				continue;
+
+			unsigned state = 0;
+			for (unsigned j = 0; j < bw->word.length(); ++j)
+			{
+				unsigned char c = this->Fold(bw->word[j]);
+				std::map<unsigned char, unsigned>::iterator it = this->states[state].next.find(c);
+				if (it != this->states[state].next.end())
+					state = it->second;
+				else
+				{
+					this->states[state].next[c] = this->states.size();
+					state = this->states.size();
+					this->states.push_back(State());
+				}
+			}
+			this->states[state].words.push_back(i);
+		}
+
+		/* Fill in the fail and output links breadth first, so the links of shorter prefixes are known first */
+		std::deque<unsigned> queue;
+		for (std::map<unsigned char, unsigned>::iterator it = this->states[0].next.begin(); it != this->states[0].next.end(); ++it)
+			queue.push_back(it->second);
+
+		while (!queue.empty())
+		{
+			unsigned state = queue.front();
+			queue.pop_front();
+
+			for (std::map<unsigned char, unsigned>::iterator it = this->states[state].next.begin(); it != this->states[state].next.end(); ++it)
+			{
+				unsigned child = it->second, fail = this->Next(this->states[state].fail, it->first);
+
+				this->states[child].fail = fail;
+				this->states[child].output = !this->states[fail].words.empty() ? fail : this->states[fail].output;
+				queue.push_back(child);
+			}
+		}
+
+		this->built = true;
+	}
+
+	/** Find the first word on the list which is in a message
+	 * @param message The message
+	 * @return The index of the word, or -1 if no word matches
+	 */
+	int Match(const Anope::string &message) const
+	{
+		int match = -1;
+		unsigned state = 0;
+
+		for (size_t i = 0; i < message.length(); ++i)
+		{
+			state = this->Next(state, this->Fold(message[i]));
+
+			for (unsigned s = this->states[state].words.empty() ? this->states[state].output : state; s; s = this->states[s].output)
+				for (unsigned j = 0; j < this->states[s].words.size(); ++j)
+				{
+					unsigned idx = this->states[s].words[j];
+					if (match != -1 && idx >= static_cast<unsigned>(match))
+						continue;
+
+					/* The word occupies [start, end) of the message, check its type's word boundaries */
+					size_t start = i + 1 - this->words[idx].first, end = i + 1;
+					bool starts = !start || message[start - 1] == ' ', ends = end == message.length() || message[end] == ' ';
+
+					switch (this->words[idx].second)
+					{
+						case BW_SINGLE:
+							if (!starts || !ends)
+								continue;
+							break;
+						case BW_START:
+							if (!starts)
+								continue;
+							break;
+						case BW_END:
+							if (!ends)
+								continue;
+							break;
+						default:
+							break;
+					}
+
+					match = idx;
+				}
+
+			if (!match)
+				break;
+		}
+
+		return match;
+	}
+};
+
 struct BadWordsImpl : BadWords
 {
 	Serialize::Reference<ChannelInfo> ci;
 	typedef std::vector<BadWordImpl *> list;
 	Serialize::Checker<list> badwords;
+	/* Built from badwords when it is next needed after they change */
+	BadWordMatcher matcher;
 
 	BadWordsImpl(Extensible *obj) : ci(anope_dynamic_static_cast<ChannelInfo *>(obj)), badwords("BadWord") { }
 
@@ -45,6 +214,7 @@ struct BadWordsImpl : BadWords
 		bw->type = type;
 
 		this->badwords->push_back(bw);
+		this->matcher.Clear();
 
 		FOREACH_MOD(OnBadWordAdd, (ci, bw));
 
@@ -82,6 +252,17 @@ struct BadWordsImpl : BadWords
 			delete this->badwords->back();
 	}
 
+	BadWord* MatchBadWord(const Anope::string &message, bool casesensitive) anope_override
+	{
+		const list &bws = *this->badwords;
+
+		if (!this->matcher.IsBuilt(casesensitive))
+			this->matcher.Build(bws, casesensitive);
+
+		int match = this->matcher.Match(message);
+		return match != -1 ? bws[match] : NULL;
+	}
+
 	void Check() anope_override
 	{
 		if (this->badwords->empty())
@@ -109,7 +290,10 @@ BadWordImpl::~BadWordImpl()
 		{
 			BadWordsImpl::list::iterator it = std::find(badwords->badwords->begin(), badwords->badwords->end(), this);
 			if (it != badwords->badwords->end())
+			{
 				badwords->badwords->erase(it);
+				badwords->matcher.Clear();
+			}
 		}
 	}
 }
@@ -140,6 +324,7 @@ Serializable* BadWordImpl::Unserialize(Serializable *obj, Serialize::Data &data)
 	BadWordsImpl *bws = ci->Require<BadWordsImpl>("badwords");
 	if (!obj)
 		bws->badwords->push_back(bw);
+	bws->matcher.Clear();
 
 	return bw;
 }
@@ -15,6 +15,38 @@
 
 static Module *me;
 
+struct KickSettings
+{
+	/* How long to keep flood and ban data */
+	time_t keepdata;
+	/* Whether to kick for bad words without saying which word matched */
+	bool gentlebadwordreason;
+};
+
+static class KickOptions : public Configuration::Settings<KickSettings>
+{
+ public:
+	KickOptions() : Configuration::Settings<KickSettings>("bs_kick", true)
+	{
+		this->Bind(&KickSettings::keepdata, "keepdata");
+		this->Bind(&KickSettings::gentlebadwordreason, "gentlebadwordreason");
+	}
+} settings;
+
+struct BotServSettings
+{
+	bool casesensitive;
+};
+
+static class BotServOptions : public Configuration::Settings<BotServSettings>
+{
+ public:
+	BotServOptions() : Configuration::Settings<BotServSettings>("botserv", true)
+	{
+		this->Bind(&BotServSettings::casesensitive, "casesensitive");
+	}
+} botserv_settings;
+
 struct KickerDataImpl : KickerData
 {
 	KickerDataImpl(Extensible *obj)
@@ -547,8 +579,8 @@ class CommandBSKickFlood : public CommandBSKickBase
 			catch (const ConvertException &) { }
 			if (kd->floodsecs < 1)
 				kd->floodsecs = 10;
-			if (kd->floodsecs > Config->GetModule(me)->Get<time_t>("keepdata"))
-				kd->floodsecs = Config->GetModule(me)->Get<time_t>("keepdata");
+			if (kd->floodsecs > settings->keepdata)
+				kd->floodsecs = settings->keepdata;
 
 			kd->flood = true;
 			if (kd->ttb[TTB_FLOOD])
@@ -952,7 +984,7 @@ struct BanData
 
 	void purge()
 	{
-		time_t keepdata = Config->GetModule(me)->Get<time_t>("keepdata");
+		time_t keepdata = settings->keepdata;
 		for (data_type::iterator it = data_map.begin(), it_end = data_map.end(); it != it_end;)
 		{
 			const Anope::string &user = it->first;
@@ -1332,88 +1364,24 @@ class BSKick : public Module
 		/* Bad words kicker */
 		if (kd->badwords)
 		{
-			bool mustkick = false;
 			BadWords *badwords = ci->GetExt<BadWords>("badwords");
 
 			/* Normalize the buffer */
 			Anope::string nbuf = Anope::NormalizeBuffer(realbuf);
-			bool casesensitive = Config->GetModule("botserv")->Get<bool>("casesensitive");
+			bool casesensitive = botserv_settings->casesensitive;
 
 			/* Normalize can return an empty string if this only contains control codes etc */
-			if (badwords && !nbuf.empty())
-				for (unsigned i = 0; i < badwords->GetBadWordCount(); ++i)
-				{
-					const BadWord *bw = badwords->GetBadWord(i);
-
-					if (bw->word.empty())
-						continue; // Shouldn't happen
-
-					if (bw->word.length() > nbuf.length())
-						continue; // This can't ever match
-
-					if (bw->type == BW_ANY && ((casesensitive && nbuf.find(bw->word) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(bw->word) != Anope::string::npos)))
-						mustkick = true;
-					else if (bw->type == BW_SINGLE)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && bw->word.equals_cs(nbuf)) || (!casesensitive && bw->word.equals_ci(nbuf)))
-							mustkick = true;
-						else if (nbuf.find(' ') == len && ((casesensitive && bw->word.equals_cs(nbuf.substr(0, len))) || (!casesensitive && bw->word.equals_ci(nbuf.substr(0, len)))))
-							mustkick = true;
-						else
-						{
-							if (len < nbuf.length() && nbuf.rfind(' ') == nbuf.length() - len - 1 && ((casesensitive && nbuf.find(bw->word) == nbuf.length() - len) || (!casesensitive && nbuf.find_ci(bw->word) == nbuf.length() - len)))
-								mustkick = true;
-							else
-							{
-								Anope::string wordbuf = " " + bw->word + " ";
-
-								if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-									mustkick = true;
-							}
-						}
-					}
-					else if (bw->type == BW_START)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && nbuf.substr(0, len).equals_cs(bw->word)) || (!casesensitive && nbuf.substr(0, len).equals_ci(bw->word)))
-							mustkick = true;
-						else
-						{
-							Anope::string wordbuf = " " + bw->word;
-
-							if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-								mustkick = true;
-						}
-					}
-					else if (bw->type == BW_END)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && nbuf.substr(nbuf.length() - len).equals_cs(bw->word)) || (!casesensitive && nbuf.substr(nbuf.length() - len).equals_ci(bw->word)))
-							mustkick = true;
-						else
-						{
-							Anope::string wordbuf = bw->word + " ";
-
-							if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-								mustkick = true;
-						}
-					}
-
-					if (mustkick)
-					{
-						check_ban(ci, u, kd, TTB_BADWORDS);
-						if (Config->GetModule(me)->Get<bool>("gentlebadwordreason"))
-							bot_kick(ci, u, _("Watch your language!"));
-						else
-							bot_kick(ci, u, _("Don't use the word \"%s\" on this channel!"), bw->word.c_str());
+			const BadWord *bw = badwords && !nbuf.empty() ? badwords->MatchBadWord(nbuf, casesensitive) : NULL;
+			if (bw)
+			{
+				check_ban(ci, u, kd, TTB_BADWORDS);
+				if (settings->gentlebadwordreason)
+					bot_kick(ci, u, _("Watch your language!"));
+				else
+					bot_kick(ci, u, _("Don't use the word \"%s\" on this channel!"), bw->word.c_str());
 
-						return;
-					}
-				} /* for */
+				return;
+			}
 		} /* if badwords */
 
 		UserData *ud = GetUserData(u, c);
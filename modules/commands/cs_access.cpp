@@ -22,6 +22,19 @@ static inline void reset_levels(ChannelInfo *ci)
 
 class AccessChanAccess : public ChanAccess
 {
+ protected:
+	bool GetPrivileges(PrivilegeSet &privs) const anope_override
+	{
+		const std::vector<Privilege> &all = PrivilegeManager::GetPrivileges();
+		for (unsigned i = 0; i < all.size(); ++i)
+		{
+			int16_t l = this->ci->GetLevel(all[i].id);
+			if (l != ACCESS_INVALID && this->level >= l)
+				privs.Set(all[i].id);
+		}
+		return true;
+	}
+
  public:
 	int level;
 
@@ -29,9 +42,12 @@ class AccessChanAccess : public ChanAccess
 	{
 	}
 
+	using ChanAccess::HasPriv;
+
 	bool HasPriv(const Anope::string &name) const anope_override
 	{
-		return this->ci->GetLevel(name) != ACCESS_INVALID && this->level >= this->ci->GetLevel(name);
+		const Privilege *p = PrivilegeManager::FindPrivilege(name);
+		return p != NULL && this->HasPriv(p->id);
 	}
 
 	Anope::string AccessSerialize() const anope_override
@@ -897,6 +913,11 @@ class CSAccess : public Module
 		if (group->ci == NULL)
 			return EVENT_CONTINUE;
 
+		/* Special case. Allows a level of -1 to match anyone, and a level of 0 to match anyone identified. */
+		int16_t level = group->ci->GetLevel(priv);
+		if (level != -1 && level != 0)
+			return EVENT_CONTINUE;
+
 		const ChanAccess *highest = group->Highest();
 		if (highest && highest->provider == &accessprovider)
 		{
@@ -909,8 +930,6 @@ class CSAccess : public Module
 				return EVENT_CONTINUE;
 		}
 
-		/* Special case. Allows a level of -1 to match anyone, and a level of 0 to match anyone identified. */
-		int16_t level = group->ci->GetLevel(priv);
 		if (level == -1)
 			return EVENT_ALLOW;
 		else if (level == 0 && group->nc && !group->nc->HasExt("UNCONFIRMED"))
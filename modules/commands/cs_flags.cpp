@@ -15,6 +15,15 @@ static std::map<Anope::string, char> defaultFlags;
 
 class FlagsChanAccess : public ChanAccess
 {
+ protected:
+	bool GetPrivileges(PrivilegeSet &privs) const anope_override
+	{
+		for (std::map<Anope::string, char>::iterator it = defaultFlags.begin(), it_end = defaultFlags.end(); it != it_end; ++it)
+			if (this->flags.count(it->second) > 0)
+				privs.Set(PrivilegeManager::GetID(it->first));
+		return true;
+	}
+
  public:
 	std::set<char> flags;
 
@@ -22,12 +31,12 @@ class FlagsChanAccess : public ChanAccess
 	{
 	}
 
+	using ChanAccess::HasPriv;
+
 	bool HasPriv(const Anope::string &priv) const anope_override
 	{
-		std::map<Anope::string, char>::iterator it = defaultFlags.find(priv);
-		if (it != defaultFlags.end() && this->flags.count(it->second) > 0)
-			return true;
-		return false;
+		const Privilege *p = PrivilegeManager::FindPrivilege(priv);
+		return p != NULL && this->HasPriv(p->id);
 	}
 
 	Anope::string AccessSerialize() const anope_override
@@ -498,6 +507,8 @@ class CSFlags : public Module
 
 			defaultFlags[p->name] = value[0];
 		}
+
+		PrivilegeManager::Invalidate();
 	}
 };
 
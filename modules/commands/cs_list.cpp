@@ -74,14 +74,18 @@ class CommandCSList : public Command
 		ListFormatter list(source.GetAccount());
 		list.AddColumn(_("Name")).AddColumn(_("Description"));
 
-		Anope::map<ChannelInfo *> ordered_map;
-		for (registered_channel_map::const_iterator it = RegisteredChannelList->begin(), it_end = RegisteredChannelList->end(); it != it_end; ++it)
-			ordered_map[it->first] = it->second;
-
-		for (Anope::map<ChannelInfo *>::const_iterator it = ordered_map.begin(), it_end = ordered_map.end(); it != it_end; ++it)
+		/* Descriptions and topics are matched too, so every channel has to be checked */
+		bool truncated = false;
+		for (registered_channel_index::const_iterator it = RegisteredChannelIndex->begin(), it_end = RegisteredChannelIndex->end(); it != it_end; ++it)
 		{
 			const ChannelInfo *ci = it->second;
 
+			if (nchans >= listmax || (to && count >= to))
+			{
+				truncated = nchans >= listmax;
+				break;
+			}
+
 			if (!is_servadmin)
 			{
 				if (ci->HasExt("CS_PRIVATE") || ci->HasExt("CS_SUSPENDED"))
@@ -127,7 +131,10 @@ class CommandCSList : public Command
 		for (unsigned i = 0; i < replies.size(); ++i)
 			source.Reply(replies[i]);
 
-		source.Reply(_("End of list - %d/%d matches shown."), nchans > listmax ? listmax : nchans, nchans);
+		if (truncated)
+			source.Reply(_("End of list - first %d matches shown."), listmax);
+		else
+			source.Reply(_("End of list - %d/%d matches shown."), nchans, nchans);
 	}
 
 	bool OnHelp(CommandSource &source, const Anope::string &subcommand) anope_override
@@ -336,7 +336,7 @@ class CommandCSMode : public Command
 							continue;
 						}
 
-						if (cm->type == MODE_LIST && ci->c && IRCD->GetMaxListFor(ci->c, cm) && ci->c->HasMode(cm->name) >= IRCD->GetMaxListFor(ci->c, cm))
+						if (cm->type == MODE_LIST && ci->c && IRCD->GetMaxListFor(ci->c, cm) && ci->c->HasMode(cm) >= IRCD->GetMaxListFor(ci->c, cm))
 						{
 							source.Reply(_("List for mode %c is full."), cm->mchar);
 							continue;
@@ -660,7 +660,7 @@ class CommandCSMode : public Command
 
 							if (adding)
 							{
-								if (IRCD->GetMaxListFor(ci->c, cm) && ci->c->HasMode(cm->name) < IRCD->GetMaxListFor(ci->c, cm))
+								if (IRCD->GetMaxListFor(ci->c, cm) && ci->c->HasMode(cm) < IRCD->GetMaxListFor(ci->c, cm))
 									ci->c->SetMode(NULL, cm, param);
 							}
 							else
@@ -972,9 +972,9 @@ class CSMode : public Module
 
 				if (cm->type == MODE_REGULAR)
 				{
-					if (!c->HasMode(cm->name) && ml->set)
+					if (!c->HasMode(cm) && ml->set)
 						c->SetMode(NULL, cm, "", false);
-					else if (c->HasMode(cm->name) && !ml->set)
+					else if (c->HasMode(cm) && !ml->set)
 						c->RemoveMode(NULL, cm, "", false);
 				}
 				else if (cm->type == MODE_PARAM)
@@ -985,12 +985,12 @@ class CSMode : public Module
 						Anope::string param;
 						c->GetParam(cm->name, param);
 
-						if (!c->HasMode(cm->name) || (!param.empty() && !ml->param.empty() && !param.equals_cs(ml->param)))
+						if (!c->HasMode(cm) || (!param.empty() && !ml->param.empty() && !param.equals_cs(ml->param)))
 							c->SetMode(NULL, cm, ml->param, false);
 					}
 					else
 					{
-						if (c->HasMode(cm->name))
+						if (c->HasMode(cm))
 							c->RemoveMode(NULL, cm, "", false);
 					}
 
@@ -19,6 +19,18 @@ namespace
 
 class XOPChanAccess : public ChanAccess
 {
+ protected:
+	bool GetPrivileges(PrivilegeSet &privs) const anope_override
+	{
+		for (std::vector<Anope::string>::iterator it = std::find(order.begin(), order.end(), this->type); it != order.end(); ++it)
+		{
+			const std::vector<Anope::string> &p = permissions[*it];
+			for (unsigned i = 0; i < p.size(); ++i)
+				privs.Set(PrivilegeManager::GetID(p[i]));
+		}
+		return true;
+	}
+
  public:
 	Anope::string type;
 
@@ -26,15 +38,12 @@ class XOPChanAccess : public ChanAccess
 	{
 	}
 
+	using ChanAccess::HasPriv;
+
 	bool HasPriv(const Anope::string &priv) const anope_override
 	{
-		for (std::vector<Anope::string>::iterator it = std::find(order.begin(), order.end(), this->type); it != order.end(); ++it)
-		{
-			const std::vector<Anope::string> &privs = permissions[*it];
-			if (std::find(privs.begin(), privs.end(), priv) != privs.end())
-				return true;
-		}
-		return false;
+		const Privilege *p = PrivilegeManager::FindPrivilege(priv);
+		return p != NULL && this->HasPriv(p->id);
 	}
 
 	Anope::string AccessSerialize() const anope_override
@@ -626,6 +635,8 @@ class CSXOP : public Module
 
 			order.push_back(cname);
 		}
+
+		PrivilegeManager::Invalidate();
 	}
 };
 
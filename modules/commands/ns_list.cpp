@@ -74,14 +74,23 @@ class CommandNSList : public Command
 
 		list.AddColumn(_("Nick")).AddColumn(_("Last usermask"));
 
-		Anope::map<NickAlias *> ordered_map;
-		for (nickalias_map::const_iterator it = NickAliasList->begin(), it_end = NickAliasList->end(); it != it_end; ++it)
-			ordered_map[it->first] = it->second;
+		/* The pattern is matched against nick!user@host, so only the nick part of its prefix can narrow down the search */
+		Anope::string prefix = Anope::GetMatchPrefix(pattern);
+		prefix = prefix.substr(0, prefix.find('!'));
 
-		for (Anope::map<NickAlias *>::const_iterator it = ordered_map.begin(), it_end = ordered_map.end(); it != it_end; ++it)
+		bool truncated = false;
+		for (nickalias_index::const_iterator it = NickAliasIndex->lower_bound(prefix), it_end = NickAliasIndex->end(); it != it_end; ++it)
 		{
 			const NickAlias *na = it->second;
 
+			if (!prefix.empty() && !it->first.substr(0, prefix.length()).equals_ci(prefix))
+				break;
+			else if (nnicks >= listmax || (to && count >= to))
+			{
+				truncated = nnicks >= listmax;
+				break;
+			}
+
 			/* Don't show private nicks to non-services admins. */
 			if (na->nc->HasExt("NS_PRIVATE") && !is_servadmin && na->nc != mync)
 				continue;
@@ -128,7 +137,10 @@ class CommandNSList : public Command
 		for (unsigned i = 0; i < replies.size(); ++i)
 			source.Reply(replies[i]);
 
-		source.Reply(_("End of list - %d/%d matches shown."), nnicks > listmax ? listmax : nnicks, nnicks);
+		if (truncated)
+			source.Reply(_("End of list - first %d matches shown."), listmax);
+		else
+			source.Reply(_("End of list - %d/%d matches shown."), nnicks, nnicks);
 		return;
 	}
 
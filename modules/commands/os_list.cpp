@@ -176,17 +176,19 @@ class CommandOSUserList : public Command
 		}
 		else
 		{
-			/* Historically this has been ordered, so... */
-			Anope::map<User *> ordered_map;
-			for (user_map::const_iterator it = UserListByNick.begin(); it != UserListByNick.end(); ++it)
-				ordered_map[it->first] = it->second;
+			/* Every mask checked below starts with the nick, so only the nick part of the prefix can narrow down the search */
+			Anope::string prefix = Anope::GetMatchPrefix(pattern);
+			prefix = prefix.substr(0, prefix.find('!'));
 
 			source.Reply(_("Users list:"));
 
-			for (Anope::map<User *>::const_iterator it = ordered_map.begin(); it != ordered_map.end(); ++it)
+			for (user_index::const_iterator it = UserIndexByNick.lower_bound(prefix); it != UserIndexByNick.end(); ++it)
 			{
 				User *u2 = it->second;
 
+				if (!prefix.empty() && !it->first.substr(0, prefix.length()).equals_ci(prefix))
+					break;
+
 				if (!pattern.empty())
 				{
 					/* check displayed host, host, and ip */
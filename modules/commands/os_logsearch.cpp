@@ -10,9 +10,284 @@
  */
 
 #include "module.h"
+#include <sys/stat.h>
 
 static unsigned int HARDMAX = 65536;
 
+/* The trigrams in a log which is no longer being written to, used to skip
+ * logs which can not contain what is being searched for.
+ */
+struct LogIndex
+{
+	/* Number of bits trigrams are hashed into */
+	static const unsigned SIZE = 1 << 20;
+
+	/* mtime and size of the log when it was indexed */
+	time_t mtime;
+	off_t size;
+	std::vector<bool> trigrams;
+
+	LogIndex() : mtime(0), size(0), trigrams(SIZE) { }
+
+	static unsigned Hash(const char *p)
+	{
+		unsigned t = Anope::tolower(p[0]) << 16 | Anope::tolower(p[1]) << 8 | Anope::tolower(p[2]);
+		return ((t * 2654435761U) >> 8) & (SIZE - 1);
+	}
+
+	void Add(const Anope::string &str)
+	{
+		for (unsigned i = 2; i < str.length(); ++i)
+			trigrams[Hash(str.c_str() + i - 2)] = true;
+	}
+
+	bool MayContain(const Anope::string &str) const
+	{
+		for (unsigned i = 2; i < str.length(); ++i)
+			if (!trigrams[Hash(str.c_str() + i - 2)])
+				return false;
+		return true;
+	}
+};
+
+/* Indexes of logs by file name. Only one search runs at a time, and
+ * this is only used by it.
+ */
+static std::map<Anope::string, LogIndex> indexes;
+
+static bool EqualsCI(char a, char b)
+{
+	return Anope::tolower(a) == Anope::tolower(b);
+}
+
+/* Searches logs in a thread, and sends the results back once done */
+class LogSearch : public Thread
+{
+	/* The oper who requested the search */
+	CommandSource source;
+	Anope::string search_string;
+	/* Logs to search, oldest first. The last one is the log currently being written to */
+	std::vector<Anope::string> logs;
+	unsigned replies;
+	bool use_index;
+
+	/* How the lines are matched */
+	enum { MATCH_REGEX, MATCH_WILDCARD, MATCH_STRING } type;
+	Anope::string mask;
+	/* Parts of the search string which all matching lines must contain */
+	std::vector<Anope::string> literals;
+
+	/* The last replies matches found */
+	std::deque<Anope::string> matches;
+	unsigned found;
+	bool aborted;
+
+	bool Matches(const Anope::string &buf) const
+	{
+		switch (this->type)
+		{
+			case MATCH_REGEX:
+				return (this->regex && this->regex->Matches(buf)) || Anope::Match(buf, this->search_string);
+			case MATCH_WILDCARD:
+				return Anope::Match(buf, this->mask);
+			default:
+				return std::search(buf.begin(), buf.end(), this->search_string.begin(), this->search_string.end(), EqualsCI) != buf.end();
+		}
+	}
+
+	/* Search one log, building its index if it has none */
+	void Search(const Anope::string &log, bool finished)
+	{
+		struct stat st;
+		if (stat(log.c_str(), &st) != 0)
+		{
+			indexes.erase(log);
+			return;
+		}
+
+		LogIndex *index = NULL;
+		if (this->use_index && finished)
+		{
+			std::map<Anope::string, LogIndex>::iterator it = indexes.find(log);
+			if (it != indexes.end() && it->second.mtime == st.st_mtime && it->second.size == st.st_size)
+			{
+				for (unsigned i = 0; i < this->literals.size(); ++i)
+					if (!it->second.MayContain(this->literals[i]))
+						return;
+			}
+			else
+				index = new LogIndex();
+		}
+
+		FILE *fd = fopen(log.c_str(), "r");
+		if (fd == NULL)
+		{
+			delete index;
+			return;
+		}
+
+		std::vector<char> block(1024 * 1024);
+		Anope::string buf;
+		for (size_t len; !this->aborted && (len = fread(&block[0], 1, block.size(), fd)) > 0;)
+		{
+			for (const char *p = &block[0], *end = p + len; p < end;)
+			{
+				const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+				buf.str().append(p, nl ? nl : end);
+				if (!nl)
+					break;
+				p = nl + 1;
+
+				if (index)
+					index->Add(buf);
+
+				if (this->Matches(buf))
+				{
+					++this->found;
+					this->matches.push_back(buf);
+					if (this->matches.size() > this->replies)
+						this->matches.pop_front();
+
+					if (this->found >= HARDMAX)
+					{
+						this->aborted = true;
+						break;
+					}
+				}
+
+				buf.clear();
+			}
+
+			if (this->GetExitState())
+				this->aborted = true;
+		}
+
+		if (!this->aborted && !buf.empty() && this->Matches(buf))
+		{
+			++this->found;
+			this->matches.push_back(buf);
+			if (this->matches.size() > this->replies)
+				this->matches.pop_front();
+		}
+
+		fclose(fd);
+
+		/* Only keep complete indexes */
+		if (index && !this->aborted)
+		{
+			index->Add(buf);
+
+			LogIndex &li = indexes[log];
+			li.mtime = st.st_mtime;
+			li.size = st.st_size;
+			li.trigrams.swap(index->trigrams);
+		}
+		delete index;
+	}
+
+ public:
+	/* Compiled regex, if the search string is one. Owned by regex_owner */
+	Regex *regex;
+	Module *regex_owner;
+
+	LogSearch(CommandSource &src, const Anope::string &str, const std::vector<Anope::string> &l, unsigned r, bool i) : source(src), search_string(str), logs(l), replies(r), use_index(i), found(0), aborted(false), regex(NULL), regex_owner(NULL)
+	{
+		if (str.length() >= 2 && str[0] == '/' && str[str.length() - 1] == '/')
+		{
+			this->type = MATCH_REGEX;
+
+			const Anope::string &regexengine = Config->GetBlock("options")->Get<const Anope::string>("regexengine");
+			ServiceReference<RegexProvider> provider("Regex", regexengine);
+			if (!regexengine.empty() && provider)
+			{
+				try
+				{
+					this->regex = provider->Compile(str.substr(1, str.length() - 2));
+					this->regex_owner = provider->owner;
+				}
+				catch (const RegexException &) { }
+			}
+		}
+		else if (str.find_first_of("?*") != Anope::string::npos)
+		{
+			this->type = MATCH_WILDCARD;
+			this->mask = "*" + str + "*";
+
+			Anope::string literal;
+			sepstream sep(str.replace_all_cs("?", "*"), '*');
+			while (sep.GetToken(literal))
+				if (literal.length() >= 3)
+					this->literals.push_back(literal);
+		}
+		else
+		{
+			this->type = MATCH_STRING;
+			if (str.length() >= 3)
+				this->literals.push_back(str);
+		}
+	}
+
+	~LogSearch()
+	{
+		delete this->regex;
+	}
+
+	void Run() anope_override
+	{
+		for (unsigned i = 0; i < this->logs.size() && !this->aborted; ++i)
+			this->Search(this->logs[i], i + 1 < this->logs.size());
+	}
+
+	/** Stop the search, and send what has been found so far
+	 */
+	void Stop()
+	{
+		this->Join();
+		if (this->source.GetUser())
+			this->SendResults();
+	}
+
+	void SendResults()
+	{
+		if (this->found >= HARDMAX)
+		{
+			source.Reply(_("Too many results for \002%s\002."), search_string.c_str());
+			return;
+		}
+		else if (this->aborted)
+		{
+			source.Reply(_("The search for \002%s\002 was aborted."), search_string.c_str());
+			return;
+		}
+		else if (!this->found)
+		{
+			source.Reply(_("No matches for \002%s\002 found."), search_string.c_str());
+			return;
+		}
+
+		source.Reply(_("Matches for \002%s\002:"), search_string.c_str());
+		unsigned int count = 0;
+		for (std::deque<Anope::string>::iterator it = matches.begin(), it_end = matches.end(); it != it_end; ++it)
+			source.Reply("#%d: %s", ++count, it->c_str());
+		source.Reply(_("Showed %d/%d matches for \002%s\002."), matches.size(), found, search_string.c_str());
+	}
+
+	void OnNotify() anope_override;
+};
+
+/* The search currently running, if any */
+static LogSearch *running = NULL;
+
+void LogSearch::OnNotify()
+{
+	Thread::OnNotify();
+	running = NULL;
+
+	/* Replies go to the user, so they must still be here */
+	if (this->source.GetUser())
+		this->SendResults();
+}
+
 class CommandOSLogSearch : public Command
 {
 	static inline Anope::string CreateLogName(const Anope::string &file, time_t t = Anope::CurTime)
@@ -89,67 +364,44 @@ class CommandOSLogSearch : public Command
 		for (; i < params.size(); ++i)
 			search_string += " " + params[i];
 
-		Log(LOG_ADMIN, source, this) << "for " << search_string;
-
-		bool wildcard = search_string.find_first_of("?*") != Anope::string::npos;
-		bool regex = search_string.empty() == false && search_string[0] == '/' && search_string[search_string.length() - 1] == '/';
-
-		const Anope::string &logfile_name = Config->GetModule(this->owner)->Get<const Anope::string>("logname");
-		std::vector<Anope::string> matches;
-		for (int d = days - 1; d >= 0; --d)
+		if (running)
 		{
-			Anope::string lf_name = CreateLogName(logfile_name, Anope::CurTime - (d * 86400));
-			Log(LOG_DEBUG) << "Searching " << lf_name;
-			std::fstream fd(lf_name.c_str(), std::ios_base::in);
-			if (!fd.is_open())
-				continue;
-
-			for (Anope::string buf, token; std::getline(fd, buf.str());)
-			{
-				bool match = false;
-
-				if (regex)
-					match = Anope::Match(buf, search_string, false, true);
-				else if (wildcard)
-					match = Anope::Match(buf, "*" + search_string + "*");
-				else
-					match = buf.find_ci(search_string) != Anope::string::npos;
+			source.Reply(_("Another log search is in progress, please try again later."));
+			return;
+		}
 
-				if (match)
-				{
-					matches.push_back(buf);
+		Log(LOG_ADMIN, source, this) << "for " << search_string;
 
-					if (matches.size() >= HARDMAX)
-						break;
-				}
-			}
+		Configuration::Block *block = Config->GetModule(this->owner);
+		const Anope::string &logfile_name = block->Get<const Anope::string>("logname");
+		std::vector<Anope::string> logs;
+		for (int d = days - 1; d >= 0; --d)
+			logs.push_back(CreateLogName(logfile_name, Anope::CurTime - (d * 86400)));
 
-			fd.close();
-		}
+		LogSearch *search = new LogSearch(source, search_string, logs, replies, block->Get<bool>("index", "yes"));
 
-		unsigned int found = matches.size();
-		if (!found)
+		/* Replies can only be sent later to users, anything else has to wait */
+		if (!source.GetUser())
 		{
-			source.Reply(_("No matches for \002%s\002 found."), search_string.c_str());
+			search->Run();
+			search->SendResults();
+			delete search;
 			return;
 		}
 
-		if (matches.size() >= HARDMAX)
+		try
 		{
-			source.Reply(_("Too many results for \002%s\002."), search_string.c_str());
-			return;
+			search->Start();
 		}
-
-		if (matches.size() > static_cast<unsigned int>(replies))
+		catch (const CoreException &ex)
 		{
-			matches.erase(matches.begin(), matches.begin() + (matches.size() - static_cast<unsigned int>(replies)));
+			Log(this->owner) << ex.GetReason();
+			delete search;
+			return;
 		}
 
-		source.Reply(_("Matches for \002%s\002:"), search_string.c_str());
-		unsigned int count = 0;
-		for (std::vector<Anope::string>::iterator it = matches.begin(), it_end = matches.end(); it != it_end; ++it)
-			source.Reply("#%d: %s", ++count, it->c_str());
-		source.Reply(_("Showed %d/%d matches for \002%s\002."), matches.size(), found, search_string.c_str());
+		running = search;
+		source.Reply(_("Searching %d days of logs for \002%s\002, the results will be sent when the search is complete."), days, search_string.c_str());
 	}
 
 	bool OnHelp(CommandSource &source, const Anope::string &subcommand) anope_override
@@ -161,7 +413,8 @@ class CommandOSLogSearch : public Command
 				"may be used to specify how many days of logs to search\n"
 				"and the number of replies to limit to. By default this\n"
 				"command searches one week of logs, and limits replies\n"
-				"to 50.\n"
+				"to 50. The search is done in the background and the\n"
+				"results are sent once it is complete.\n"
 				" \n"
 				"For example:\n"
 				"    \002LOGSEARCH +21d +500l Anope\002\n"
@@ -175,11 +428,38 @@ class OSLogSearch : public Module
 {
 	CommandOSLogSearch commandoslogsearch;
 
+	void Abort()
+	{
+		running->Stop();
+		delete running;
+		running = NULL;
+	}
+
  public:
 	OSLogSearch(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		commandoslogsearch(this)
 	{
 	}
+
+	~OSLogSearch()
+	{
+		if (running)
+			this->Abort();
+		indexes.clear();
+	}
+
+	void OnReload(Configuration::Conf *conf) anope_override
+	{
+		if (!running && !conf->GetModule(this)->Get<bool>("index", "yes"))
+			indexes.clear();
+	}
+
+	void OnModuleUnload(User *, Module *m) anope_override
+	{
+		/* The regex must be deleted before the module providing it goes away */
+		if (running && running->regex_owner == m)
+			this->Abort();
+	}
 };
 
 MODULE_INIT(OSLogSearch)
@@ -11,6 +11,7 @@
 
 #include "module.h"
 #include "modules/os_session.h"
+#include "regexpr.h"
 
 struct Stats : Serializable
 {
@@ -196,12 +197,24 @@ class CommandOSStats : public Command
 		}
 	}
 
+	void DoStatsCache(CommandSource &source)
+	{
+		size_t entries;
+		unsigned long hits, misses;
+
+		Anope::GetRegexCacheStats(entries, hits, misses);
+		source.Reply(_("Regular expressions: %lu entries, %lu hits, %lu misses"), entries, hits, misses);
+
+		ChannelInfo::GetAccessCacheStats(hits, misses);
+		source.Reply(_("Channel access: %lu hits, %lu misses"), hits, misses);
+	}
+
  public:
 	CommandOSStats(Module *creator) : Command(creator, "operserv/stats", 0, 1),
 		akills("XLineManager", "xlinemanager/sgline"), snlines("XLineManager", "xlinemanager/snline"), sqlines("XLineManager", "xlinemanager/sqline")
 	{
 		this->SetDesc(_("Show status of Services and network"));
-		this->SetSyntax("[AKILL | HASH | UPLINK | UPTIME | ALL | RESET]");
+		this->SetSyntax("[AKILL | CACHE | HASH | UPLINK | UPTIME | ALL | RESET]");
 	}
 
 	void Execute(CommandSource &source, const std::vector<Anope::string> &params) anope_override
@@ -216,6 +229,9 @@ class CommandOSStats : public Command
 		if (extra.equals_ci("ALL") || extra.equals_ci("AKILL"))
 			this->DoStatsAkill(source);
 
+		if (extra.equals_ci("ALL") || extra.equals_ci("CACHE"))
+			this->DoStatsCache(source);
+
 		if (extra.equals_ci("ALL") || extra.equals_ci("HASH"))
 			this->DoStatsHash(source);
 
@@ -225,7 +241,7 @@ class CommandOSStats : public Command
 		if (extra.empty() || extra.equals_ci("ALL") || extra.equals_ci("UPTIME"))
 			this->DoStatsUptime(source);
 
-		if (!extra.empty() && !extra.equals_ci("ALL") && !extra.equals_ci("AKILL") && !extra.equals_ci("HASH") && !extra.equals_ci("UPLINK") && !extra.equals_ci("UPTIME"))
+		if (!extra.empty() && !extra.equals_ci("ALL") && !extra.equals_ci("AKILL") && !extra.equals_ci("CACHE") && !extra.equals_ci("HASH") && !extra.equals_ci("UPLINK") && !extra.equals_ci("UPTIME"))
 			source.Reply(_("Unknown STATS option: \002%s\002"), extra.c_str());
 	}
 
@@ -246,6 +262,9 @@ class CommandOSStats : public Command
 				"The \002UPLINK\002 option displays information about the current\n"
 				"server Anope uses as an uplink to the network.\n"
 				" \n"
+				"The \002CACHE\002 option displays information about the caches of\n"
+				"compiled regular expressions and of resolved channel access.\n"
+				" \n"
 				"The \002HASH\002 option displays information about the hash maps.\n"
 				" \n"
 				"The \002ALL\002 option displays all of the above statistics."));
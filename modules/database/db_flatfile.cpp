@@ -19,7 +19,7 @@ class SaveData : public Serialize::Data
 {
  public:
 	Anope::string last;
-	std::fstream *fs;
+	std::iostream *fs;
 
 	SaveData() : fs(NULL) { }
 
@@ -35,11 +35,37 @@ class SaveData : public Serialize::Data
 	}
 };
 
+/* Serializes a single object into memory, so it can be compared against
+ * what was last committed before it is appended to the journal.
+ */
+class JournalData : public SaveData
+{
+ public:
+	std::stringstream buf;
+
+	JournalData()
+	{
+		fs = &buf;
+	}
+
+	size_t Hash() const anope_override
+	{
+		return Anope::hash_cs()(buf.str());
+	}
+
+	void Reset()
+	{
+		last.clear();
+		buf.str("");
+		buf.clear();
+	}
+};
+
 class LoadData : public Serialize::Data
 {
  public:
 	std::fstream *fs;
-	unsigned int id;
+	uint64_t id;
 	std::map<Anope::string, Anope::string> data;
 	std::stringstream ss;
 	bool read;
@@ -56,7 +82,7 @@ class LoadData : public Serialize::Data
 				{
 					try
 					{
-						this->id = convertTo<unsigned int>(token.substr(3));
+						this->id = convertTo<uint64_t>(token.substr(3));
 					}
 					catch (const ConvertException &) { }
 
@@ -103,6 +129,60 @@ class LoadData : public Serialize::Data
 	}
 };
 
+/* The location of a single object within a database or journal */
+struct ObjectRecord
+{
+	std::fstream *fs;
+	std::streampos pos;
+
+	ObjectRecord(std::fstream *f, std::streampos p) : fs(f), pos(p) { }
+};
+
+/* Every object of a single type found in a database and its journal, in load order */
+struct TypeRecords
+{
+	std::vector<ObjectRecord> records;
+	std::map<uint64_t, size_t> ids;
+
+	void Add(std::fstream *fs, std::streampos pos, uint64_t id)
+	{
+		if (id)
+		{
+			std::map<uint64_t, size_t>::iterator it = ids.find(id);
+			if (it != ids.end())
+			{
+				/* A newer copy of an object we already know about, keep its original position */
+				records[it->second] = ObjectRecord(fs, pos);
+				return;
+			}
+
+			ids[id] = records.size();
+		}
+
+		records.push_back(ObjectRecord(fs, pos));
+	}
+
+	void Delete(uint64_t id)
+	{
+		std::map<uint64_t, size_t>::iterator it = ids.find(id);
+		if (it != ids.end())
+		{
+			records[it->second].fs = NULL;
+			ids.erase(it);
+		}
+	}
+};
+
+/* An object which was deleted since the journal was last written */
+struct Tombstone
+{
+	Anope::string db_name;
+	Anope::string type;
+	uint64_t id;
+
+	Tombstone(const Anope::string &d, const Anope::string &t, uint64_t i) : db_name(d), type(t), id(i) { }
+};
+
 class DBFlatFile : public Module, public Pipe
 {
 	/* Day the last backup was on */
@@ -113,6 +193,27 @@ class DBFlatFile : public Module, public Pipe
 
 	int child_pid;
 
+	/* Snapshot stamp of each database the journal is written against */
+	std::map<Anope::string, time_t> stamps;
+	/* The stamp given to the last snapshot written */
+	time_t last_stamp;
+	/* Last time a full snapshot was written */
+	time_t last_compact;
+	/* Highest object id of each type */
+	std::map<Anope::string, uint64_t> last_ids;
+	/* Objects deleted since the journal was last written */
+	std::vector<Tombstone> tombstones;
+	/* Module being unloaded, objects of types it owns are not deleted from the database */
+	Module *unloading;
+	bool shutting_down;
+
+	Anope::string GetDatabaseName(Module *owner)
+	{
+		if (owner)
+			return Anope::DataDir + "/module_" + owner->name + ".db";
+		return Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+	}
+
 	void BackupDatabase()
 	{
 		tm *tm = localtime(&Anope::CurTime);
@@ -159,25 +260,305 @@ class DBFlatFile : public Module, public Pipe
 					continue;
 				}
 
+				/* The journal is only meaningful alongside the snapshot it was written against */
+				if (Anope::IsFile(oldname + ".journal"))
+					rename((oldname + ".journal").c_str(), (newname + ".journal").c_str());
+
 				backups[*it].push_back(newname);
 
 				unsigned keepbackups = Config->GetModule(this)->Get<unsigned>("keepbackups");
 				if (keepbackups > 0 && backups[*it].size() > keepbackups)
 				{
 					unlink(backups[*it].front().c_str());
+					unlink((backups[*it].front() + ".journal").c_str());
 					backups[*it].pop_front();
 				}
 			}
 		}
 	}
 
+	/* Finds every object of the given types in db_name and, if it was written against
+	 * the same snapshot, its journal, and unserializes them.
+	 */
+	bool LoadDatabase(const Anope::string &db_name, const std::vector<Serialize::Type *> &types)
+	{
+		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!fd.is_open())
+		{
+			Log(this) << "Unable to open " << db_name << " for reading!";
+			return false;
+		}
+
+		std::map<Anope::string, TypeRecords> index;
+		time_t stamp = IndexDatabase(fd, index);
+
+		std::fstream jd;
+		if (stamp)
+		{
+			jd.open((db_name + ".journal").c_str(), std::ios_base::in | std::ios_base::binary);
+			if (jd.is_open())
+			{
+				time_t jstamp = IndexDatabase(jd, index);
+				if (jstamp != stamp)
+				{
+					Log(this) << "Ignoring journal " << db_name << ".journal as it does not belong to the current database";
+					index.clear();
+					fd.clear();
+					fd.seekg(0);
+					IndexDatabase(fd, index);
+				}
+			}
+		}
+
+		if (!this->stamps.count(db_name))
+			this->stamps[db_name] = stamp;
+		this->last_stamp = std::max(this->last_stamp, stamp);
+
+		bool journal = Config->GetModule(this)->Get<bool>("journal");
+		LoadData ld;
+		JournalData jdata;
+
+		for (unsigned i = 0; i < types.size(); ++i)
+		{
+			Serialize::Type *stype = types[i];
+			std::vector<ObjectRecord> &records = index[stype->GetName()].records;
+			uint64_t &last_id = this->last_ids[stype->GetName()];
+
+			for (unsigned j = 0; j < records.size(); ++j)
+			{
+				if (!records[j].fs)
+					continue;
+
+				records[j].fs->clear();
+				records[j].fs->seekg(records[j].pos);
+
+				ld.fs = records[j].fs;
+				Serializable *obj = stype->Unserialize(NULL, ld);
+				if (obj != NULL)
+				{
+					obj->id = ld.id;
+					if (obj->id > last_id)
+						last_id = obj->id;
+
+					if (journal)
+					{
+						/* We know this is the most up to date copy */
+						jdata.Reset();
+						obj->Serialize(jdata);
+						obj->UpdateCache(jdata);
+					}
+				}
+				ld.Reset();
+			}
+		}
+
+		return true;
+	}
+
+	/* Builds an index of where each object is in fd, and returns the snapshot stamp found in it, if any.
+	 * Objects which are not terminated by END (eg from a partially written journal) are ignored.
+	 */
+	time_t IndexDatabase(std::fstream &fd, std::map<Anope::string, TypeRecords> &index)
+	{
+		time_t stamp = 0;
+		Anope::string stype;
+		std::streampos pos;
+		uint64_t id = 0;
+
+		for (Anope::string buf; std::getline(fd, buf.str());)
+		{
+			if (buf.find("OBJECT ") == 0)
+			{
+				stype = buf.substr(7);
+				pos = fd.tellg();
+				id = 0;
+			}
+			else if (buf.find("ID ") == 0)
+			{
+				try
+				{
+					id = convertTo<uint64_t>(buf.substr(3));
+				}
+				catch (const ConvertException &) { }
+			}
+			else if (buf == "END")
+			{
+				if (!stype.empty())
+					index[stype].Add(&fd, pos, id);
+				stype.clear();
+			}
+			else if (buf.find("DELETE ") == 0)
+			{
+				spacesepstream sep(buf.substr(7));
+				Anope::string dtype, did;
+				if (sep.GetToken(dtype) && sep.GetToken(did))
+				{
+					try
+					{
+						index[dtype].Delete(convertTo<uint64_t>(did));
+					}
+					catch (const ConvertException &) { }
+				}
+			}
+			else if (buf.find("SNAPSHOT ") == 0)
+			{
+				try
+				{
+					stamp = convertTo<time_t>(buf.substr(9));
+				}
+				catch (const ConvertException &) { }
+			}
+		}
+
+		return stamp;
+	}
+
+	void AssignID(Serializable *obj)
+	{
+		if (!obj->id)
+			obj->id = ++this->last_ids[obj->GetSerializableType()->GetName()];
+	}
+
+	bool NeedsCompaction()
+	{
+		if (Anope::Quitting || localtime(&Anope::CurTime)->tm_mday != last_day)
+			return true;
+
+		if (Anope::CurTime - last_compact >= Config->GetModule(this)->Get<time_t>("compactinterval", "1h"))
+			return true;
+
+		/* Databases without a snapshot stamp can not have a journal */
+		for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
+		{
+			std::map<Anope::string, time_t>::iterator sit = this->stamps.find(GetDatabaseName(it->second->GetOwner()));
+			if (sit == this->stamps.end() || !sit->second)
+				return true;
+		}
+
+		return false;
+	}
+
+	std::fstream *OpenJournal(std::map<Anope::string, std::fstream *> &journals, const Anope::string &db_name)
+	{
+		std::fstream *&fs = journals[db_name];
+		if (fs)
+			return fs;
+
+		const Anope::string &journal_name = db_name + ".journal";
+		time_t stamp = this->stamps[db_name];
+
+		/* Throw away whatever is in the journal if it was written against a different snapshot */
+		bool fresh = true;
+		std::fstream in(journal_name.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (in.is_open())
+		{
+			Anope::string buf;
+			fresh = !std::getline(in, buf.str()) || buf != "SNAPSHOT " + stringify(stamp);
+			in.close();
+		}
+
+		fs = new std::fstream(journal_name.c_str(), std::ios_base::out | (fresh ? std::ios_base::trunc : std::ios_base::app) | std::ios_base::binary);
+		if (!fs->is_open())
+			Log(this) << "Unable to open " << journal_name << " for writing";
+		else if (fresh)
+			*fs << "SNAPSHOT " << stamp << "\n";
+
+		return fs;
+	}
+
+	/* Appends every object that has changed since it was last written, and every
+	 * object deleted since then, to the journals.
+	 */
+	void WriteJournal()
+	{
+		std::map<Anope::string, std::fstream *> journals;
+		unsigned count = 0;
+
+		for (unsigned i = 0; i < this->tombstones.size(); ++i)
+		{
+			const Tombstone &t = this->tombstones[i];
+			std::fstream *fs = OpenJournal(journals, t.db_name);
+			if (fs->is_open())
+				*fs << "DELETE " << t.type << " " << t.id << "\n";
+		}
+		this->tombstones.clear();
+
+		JournalData data;
+		const std::list<Serializable *> &items = Serializable::GetItems();
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *base = *it;
+			Serialize::Type *s_type = base->GetSerializableType();
+			if (!s_type)
+				continue;
+
+			data.Reset();
+			base->Serialize(data);
+
+			if (base->IsCached(data))
+				continue;
+
+			std::fstream *fs = OpenJournal(journals, GetDatabaseName(s_type->GetOwner()));
+			if (!fs->is_open())
+				continue;
+
+			AssignID(base);
+			*fs << "OBJECT " << s_type->GetName() << "\nID " << base->id << data.buf.str() << "\nEND\n";
+			base->UpdateCache(data);
+			++count;
+		}
+
+		bool failed = false;
+		for (std::map<Anope::string, std::fstream *>::iterator it = journals.begin(), it_end = journals.end(); it != it_end; ++it)
+		{
+			std::fstream *f = it->second;
+
+			if (!f->is_open() || !f->good())
+			{
+				Log(this) << "Unable to write journal " << it->first << ".journal";
+				failed = true;
+			}
+
+			f->close();
+			delete f;
+		}
+
+		if (failed)
+		{
+			/* We don't know what made it to disk, so write everything next time */
+			this->stamps.clear();
+
+			if (!Config->GetModule(this)->Get<bool>("nobackupokay"))
+				Anope::Quitting = true;
+		}
+		else
+			Log(LOG_DEBUG) << "db_flatfile: Wrote " << count << " objects to the journal";
+	}
+
+	/* Marks every object as committed, as it is about to be written to a snapshot */
+	void UpdateCaches()
+	{
+		JournalData data;
+		const std::list<Serializable *> &items = Serializable::GetItems();
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *base = *it;
+			if (!base->GetSerializableType())
+				continue;
+
+			data.Reset();
+			base->Serialize(data);
+			base->UpdateCache(data);
+		}
+	}
+
  public:
-	DBFlatFile(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), last_day(0), loaded(false), child_pid(-1)
+	DBFlatFile(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), last_day(0), loaded(false), child_pid(-1),
+		last_stamp(0), last_compact(0), unloading(NULL), shutting_down(false)
 	{
 
 	}
 
-#ifndef _WIN32
 	void OnRestart() anope_override
 	{
 		OnShutdown();
@@ -185,6 +566,9 @@ class DBFlatFile : public Module, public Pipe
 
 	void OnShutdown() anope_override
 	{
+		shutting_down = true;
+
+#ifndef _WIN32
 		if (child_pid > -1)
 		{
 			Log(this) << "Waiting for child to exit...";
@@ -194,8 +578,8 @@ class DBFlatFile : public Module, public Pipe
 
 			Log(this) << "Done";
 		}
-	}
 #endif
+	}
 
 	void OnNotify() anope_override
 	{
@@ -215,6 +599,9 @@ class DBFlatFile : public Module, public Pipe
 
 		Log(this) << "Error saving databases: " << buf;
 
+		/* The journal can not be appended to a snapshot that failed to write */
+		this->stamps.clear();
+
 		if (!Config->GetModule(this)->Get<bool>("nobackupokay"))
 			Anope::Quitting = true;
 	}
@@ -222,47 +609,17 @@ class DBFlatFile : public Module, public Pipe
 	EventReturn OnLoadDatabase() anope_override
 	{
 		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
-		std::set<Anope::string> tried_dbs;
-
-		const Anope::string &db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
-
-		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
-		if (!fd.is_open())
-		{
-			Log(this) << "Unable to open " << db_name << " for reading!";
-			return EVENT_STOP;
-		}
-
-		std::map<Anope::string, std::vector<std::streampos> > positions;
-
-		for (Anope::string buf; std::getline(fd, buf.str());)
-			if (buf.find("OBJECT ") == 0)
-				positions[buf.substr(7)].push_back(fd.tellg());
-
-		LoadData ld;
-		ld.fs = &fd;
+		std::vector<Serialize::Type *> types;
 
 		for (unsigned i = 0; i < type_order.size(); ++i)
 		{
 			Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
-			if (!stype || stype->GetOwner())
-				continue;
-
-			std::vector<std::streampos> &pos = positions[stype->GetName()];
-
-			for (unsigned j = 0; j < pos.size(); ++j)
-			{
-				fd.clear();
-				fd.seekg(pos[j]);
-
-				Serializable *obj = stype->Unserialize(NULL, ld);
-				if (obj != NULL)
-					obj->id = ld.id;
-				ld.Reset();
-			}
+			if (stype && !stype->GetOwner())
+				types.push_back(stype);
 		}
 
-		fd.close();
+		if (!LoadDatabase(GetDatabaseName(NULL), types))
+			return EVENT_STOP;
 
 		loaded = true;
 		return EVENT_STOP;
@@ -277,8 +634,36 @@ class DBFlatFile : public Module, public Pipe
 			return;
 		}
 
+		this->unloading = NULL;
+
+		bool journal = Config->GetModule(this)->Get<bool>("journal");
+		if (journal && !NeedsCompaction())
+		{
+			WriteJournal();
+			return;
+		}
+
 		BackupDatabase();
 
+		time_t stamp = 0;
+		this->stamps.clear();
+		this->tombstones.clear();
+
+		if (journal)
+		{
+			stamp = this->last_stamp = std::max(Anope::CurTime, this->last_stamp + 1);
+			this->last_compact = Anope::CurTime;
+
+			/* Every object in a snapshot needs an id for the journal to refer to it by */
+			const std::list<Serializable *> &items = Serializable::GetItems();
+			for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+				if ((*it)->GetSerializableType())
+					AssignID(*it);
+
+			for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
+				this->stamps[GetDatabaseName(it->second->GetOwner())] = stamp;
+		}
+
 		int i = -1;
 #ifndef _WIN32
 		if (!Anope::Quitting && Config->GetModule(this)->Get<bool>("fork"))
@@ -286,6 +671,8 @@ class DBFlatFile : public Module, public Pipe
 			i = fork();
 			if (i > 0)
 			{
+				if (journal)
+					UpdateCaches();
 				child_pid = i;
 				return;
 			}
@@ -306,19 +693,18 @@ class DBFlatFile : public Module, public Pipe
 				if (databases[s_type->GetOwner()])
 					continue;
 
-				Anope::string db_name;
-				if (s_type->GetOwner())
-					db_name = Anope::DataDir + "/module_" + s_type->GetOwner()->name + ".db";
-				else
-					db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+				const Anope::string &db_name = GetDatabaseName(s_type->GetOwner());
 
 				std::fstream *fs = databases[s_type->GetOwner()] = new std::fstream((db_name + ".tmp").c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
 
 				if (!fs->is_open())
 					Log(this) << "Unable to open " << db_name << " for writing";
+				else if (stamp)
+					*fs << "SNAPSHOT " << stamp << "\n";
 			}
 
 			SaveData data;
+			JournalData jdata;
 			const std::list<Serializable *> &items = Serializable::GetItems();
 			for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
 			{
@@ -326,20 +712,34 @@ class DBFlatFile : public Module, public Pipe
 				Serialize::Type *s_type = base->GetSerializableType();
 
 				data.fs = databases[s_type->GetOwner()];
-				if (!data.fs || !data.fs->is_open())
+				if (!data.fs || !data.fs->good())
 					continue;
 
 				*data.fs << "OBJECT " << s_type->GetName();
 				if (base->id)
 					*data.fs << "\nID " << base->id;
-				base->Serialize(data);
+
+				if (journal)
+				{
+					/* Remember what was committed so the journal only has to contain what changes */
+					jdata.Reset();
+					base->Serialize(jdata);
+					*data.fs << jdata.buf.str();
+					base->UpdateCache(jdata);
+				}
+				else
+				{
+					data.last.clear();
+					base->Serialize(data);
+				}
+
 				*data.fs << "\nEND\n";
 			}
 
 			for (std::map<Module *, std::fstream *>::iterator it = databases.begin(), it_end = databases.end(); it != it_end; ++it)
 			{
 				std::fstream *f = it->second;
-				const Anope::string &db_name = Anope::DataDir + "/" + (it->first ? (it->first->name + ".db") : Config->GetModule(this)->Get<const Anope::string>("database", "anope.db"));
+				const Anope::string &db_name = GetDatabaseName(it->first);
 
 				if (!f->is_open() || !f->good())
 				{
@@ -355,6 +755,8 @@ class DBFlatFile : public Module, public Pipe
 					remove(db_name.c_str());
 #endif
 					rename((db_name + ".tmp").c_str(), db_name.c_str());
+					/* Everything in the journal is now in the snapshot */
+					remove((db_name + ".journal").c_str());
 				}
 
 				delete f;
@@ -379,32 +781,31 @@ class DBFlatFile : public Module, public Pipe
 		if (!loaded)
 			return;
 
-		Anope::string db_name;
-		if (stype->GetOwner())
-			db_name = Anope::DataDir + "/module_" + stype->GetOwner()->name + ".db";
-		else
-			db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+		LoadDatabase(GetDatabaseName(stype->GetOwner()), std::vector<Serialize::Type *>(1, stype));
+	}
 
-		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
-		if (!fd.is_open())
-		{
-			Log(this) << "Unable to open " << db_name << " for reading!";
+	void OnSerializableDestruct(Serializable *obj) anope_override
+	{
+		Serialize::Type *s_type = obj->GetSerializableType();
+		if (!s_type || !obj->id || shutting_down)
 			return;
-		}
 
-		LoadData ld;
-		ld.fs = &fd;
+		/* Objects are destroyed when the module owning them is unloaded, but they are still in its database */
+		if (s_type->GetOwner() && s_type->GetOwner() == this->unloading)
+			return;
 
-		for (Anope::string buf; std::getline(fd, buf.str());)
-		{
-			if (buf == "OBJECT " + stype->GetName())
-			{
-				stype->Unserialize(NULL, ld);
-				ld.Reset();
-			}
-		}
+		if (Config->GetModule(this)->Get<bool>("journal"))
+			this->tombstones.push_back(Tombstone(GetDatabaseName(s_type->GetOwner()), s_type->GetName(), obj->id));
+	}
 
-		fd.close();
+	void OnModuleLoad(User *, Module *) anope_override
+	{
+		this->unloading = NULL;
+	}
+
+	void OnModuleUnload(User *, Module *m) anope_override
+	{
+		this->unloading = m;
 	}
 };
 
@@ -69,6 +69,7 @@ class ObjectLoader : public Interface
 	ObjectLoader(Module *creator, const Anope::string &t, int64_t i) : Interface(creator), type(t), id(i) { }
 
 	void OnResult(const Reply &r) anope_override;
+	void OnError(const Anope::string &error) anope_override;
 };
 
 class IDInterface : public Interface
@@ -123,15 +124,75 @@ class DatabaseRedis : public Module, public Pipe
 	SubscriptionListener sl;
 	std::set<Serializable *> updated_items;
 
+	/* Objects waiting to be fetched, in type order */
+	std::deque<std::pair<Anope::string, int64_t> > load_queue;
+	/* Number of objects being fetched */
+	unsigned load_pending;
+	/* Maximum number of objects to fetch at once */
+	unsigned load_batch;
+
+	/* Progress of the initial load */
+	bool loading;
+	size_t load_total, load_done;
+	time_t load_start, load_report;
+
  public:
 	ServiceReference<Provider> redis;
 
-	DatabaseRedis(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sl(this)
+	DatabaseRedis(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sl(this),
+		load_pending(0), load_batch(1000), loading(false), load_total(0), load_done(0), load_start(0), load_report(0)
 	{
 		me = this;
 
 	}
 
+	/* Queue objects of a type to be fetched */
+	void QueueObjects(const Anope::string &tname, const std::vector<int64_t> &ids)
+	{
+		for (unsigned i = 0; i < ids.size(); ++i)
+			load_queue.push_back(std::make_pair(tname, ids[i]));
+		load_total += ids.size();
+
+		this->LoadObjects();
+	}
+
+	/* Pipeline HGETALLs for queued objects, keeping at most load_batch outstanding */
+	void LoadObjects()
+	{
+		if (!redis)
+			return;
+
+		std::vector<Anope::string> args;
+		for (; load_pending < load_batch && !load_queue.empty(); load_queue.pop_front())
+		{
+			const std::pair<Anope::string, int64_t> &obj = load_queue.front();
+
+			args.clear();
+			args.push_back("HGETALL");
+			args.push_back("hash:" + obj.first + ":" + stringify(obj.second));
+
+			redis->SendCommand(new ObjectLoader(this, obj.first, obj.second), args);
+			++load_pending;
+		}
+	}
+
+	/* Called when an object fetch finishes */
+	void ObjectLoaded()
+	{
+		--load_pending;
+		++load_done;
+
+		if (loading)
+		{
+			time_t now = time(NULL);
+			if (now - load_report >= 5)
+			{
+				Log(this) << "Loaded " << load_done << " of " << load_total << " objects";
+				load_report = now;
+			}
+		}
+	}
+
 	/* Insert or update an object */
 	void InsertObject(Serializable *obj)
 	{
@@ -175,6 +236,7 @@ class DatabaseRedis : public Module, public Pipe
 	{
 		Configuration::Block *block = conf->GetModule(this);
 		this->redis = ServiceReference<Provider>("Redis::Provider", block->Get<const Anope::string>("engine", "redis/main"));
+		this->load_batch = std::max(block->Get<unsigned>("loadbatch", "1000"), 1U);
 	}
 
 	EventReturn OnLoadDatabase() anope_override
@@ -192,7 +254,15 @@ class DatabaseRedis : public Module, public Pipe
 			this->OnSerializeTypeCreate(sb);
 		}
 
-		while (!redis->IsSocketDead() && redis->BlockAndProcess());
+		loading = true;
+		load_start = load_report = time(NULL);
+
+		/* Objects whose fetch failed are not replaced, so top up here too */
+		do
+			this->LoadObjects();
+		while (!redis->IsSocketDead() && (redis->BlockAndProcess() || !load_queue.empty()));
+
+		loading = false;
 
 		if (redis->IsSocketDead())
 		{
@@ -200,6 +270,8 @@ class DatabaseRedis : public Module, public Pipe
 			return EVENT_CONTINUE;
 		}
 
+		Log(this) << "Loaded " << load_done << " objects in " << (time(NULL) - load_start) << " seconds";
+
 		redis->Subscribe(&this->sl, "__keyspace@*__:hash:*");
 
 		return EVENT_STOP;
@@ -266,6 +338,9 @@ void TypeLoader::OnResult(const Reply &r)
 		return;
 	}
 
+	std::vector<int64_t> ids;
+	ids.reserve(r.multi_bulk.size());
+
 	for (unsigned i = 0; i < r.multi_bulk.size(); ++i)
 	{
 		const Reply *reply = r.multi_bulk[i];
@@ -273,23 +348,18 @@ void TypeLoader::OnResult(const Reply &r)
 		if (reply->type != Reply::BULK)
 			continue;
 
-		int64_t id;
 		try
 		{
-			id = convertTo<int64_t>(reply->bulk);
+			ids.push_back(convertTo<int64_t>(reply->bulk));
 		}
 		catch (const ConvertException &)
 		{
 			continue;
 		}
-
-		std::vector<Anope::string> args;
-		args.push_back("HGETALL");
-		args.push_back("hash:" + this->type + ":" + stringify(id));
-
-		me->redis->SendCommand(new ObjectLoader(me, this->type, id), args);
 	}
 
+	me->QueueObjects(this->type, ids);
+
 	delete this;
 }
 
@@ -297,6 +367,9 @@ void ObjectLoader::OnResult(const Reply &r)
 {
 	Serialize::Type *st = Serialize::Type::Find(this->type);
 
+	me->ObjectLoaded();
+	me->LoadObjects();
+
 	if (r.type != Reply::MULTI_BULK || r.multi_bulk.empty() || !me->redis || !st)
 	{
 		delete this;
@@ -324,6 +397,16 @@ void ObjectLoader::OnResult(const Reply &r)
 	delete this;
 }
 
+void ObjectLoader::OnError(const Anope::string &error)
+{
+	Interface::OnError(error);
+
+	/* This may be the module unloading, so do not fetch any more here */
+	me->ObjectLoaded();
+
+	delete this;
+}
+
 void IDInterface::OnResult(const Reply &r)
 {
 	if (!o || r.type != Reply::INT || !r.i)
@@ -55,12 +55,29 @@ public:
 	}
 };
 
+class DBSQL;
+
+/** Periodically writes the pending updates, if a flush interval is configured
+ */
+class FlushTimer : public Timer
+{
+	DBSQL *db;
+
+ public:
+	FlushTimer(DBSQL *d, long timeout) : Timer(timeout, Anope::CurTime, true), db(d) { }
+
+	void Tick(time_t) anope_override;
+};
+
 class DBSQL : public Module, public Pipe
 {
 	ServiceReference<Provider> sql;
 	SQLSQLInterface sqlinterface;
 	Anope::string prefix;
 	bool import;
+	/* Maximum number of rows updated by a single query */
+	unsigned batchsize;
+	FlushTimer *flush_timer;
 
 	std::set<Serializable *> updated_items;
 	bool shutting_down;
@@ -89,8 +106,20 @@ class DBSQL : public Module, public Pipe
 			this->sql->RunQuery(q);
 	}
 
+	/* We are importing objects from another database module, so don't do asynchronous
+	 * queries in case the core has to shut down, it will cut short the import
+	 */
+	void RunImport(const Query &q)
+	{
+		if (this->imported)
+			this->RunBackground(q);
+		else
+			this->sql->RunQuery(q);
+	}
+
  public:
-	DBSQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sql("", ""), sqlinterface(this), shutting_down(false), loading_databases(false), loaded(false), imported(false)
+	DBSQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sql("", ""), sqlinterface(this), batchsize(0), flush_timer(NULL),
+		shutting_down(false), loading_databases(false), loaded(false), imported(false)
 	{
 
 
@@ -98,48 +127,60 @@ class DBSQL : public Module, public Pipe
 			throw ModuleException("db_sql can not be loaded after db_sql_live");
 	}
 
+	~DBSQL()
+	{
+		delete this->flush_timer;
+	}
+
 	void OnNotify() anope_override
 	{
+		/* Updates to existing objects, by table and id */
+		std::map<Anope::string, std::map<unsigned int, Data *> > batches;
+
 		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
 		{
 			Serializable *obj = *it;
 
 			if (this->sql)
 			{
-				Data data;
-				obj->Serialize(data);
+				Data *data = new Data();
+				obj->Serialize(*data);
 
-				if (obj->IsCached(data))
-					continue;
-
-				obj->UpdateCache(data);
+				bool skip = obj->IsCached(*data);
+				if (!skip)
+				{
+					obj->UpdateCache(*data);
 
-				/* If we didn't load these objects and we don't want to import just update the cache and continue */
-				if (!this->loaded && !this->imported && !this->import)
-					continue;
+					/* If we didn't load these objects and we don't want to import just update the cache and continue */
+					skip = !this->loaded && !this->imported && !this->import;
+				}
 
 				Serialize::Type *s_type = obj->GetSerializableType();
-				if (!s_type)
+				if (skip || !s_type)
+				{
+					delete data;
 					continue;
+				}
 
-				std::vector<Query> create = this->sql->CreateTable(this->prefix + s_type->GetName(), data);
-				Query insert = this->sql->BuildInsert(this->prefix + s_type->GetName(), obj->id, data);
+				const Anope::string &table = this->prefix + s_type->GetName();
 
-				if (this->imported)
+				std::vector<Query> create = this->sql->CreateTable(table, *data);
+				for (unsigned i = 0; i < create.size(); ++i)
+					this->RunImport(create[i]);
+
+				if (obj->id > 0)
 				{
-					for (unsigned i = 0; i < create.size(); ++i)
-						this->RunBackground(create[i]);
+					batches[table][obj->id] = data;
+					continue;
+				}
 
+				Query insert = this->sql->BuildInsert(table, obj->id, *data);
+				delete data;
+
+				if (this->imported)
 					this->RunBackground(insert, new ResultSQLSQLInterface(this, obj));
-				}
 				else
 				{
-					for (unsigned i = 0; i < create.size(); ++i)
-						this->sql->RunQuery(create[i]);
-
-					/* We are importing objects from another database module, so don't do asynchronous
-					 * queries in case the core has to shut down, it will cut short the import
-					 */
 					Result r = this->sql->RunQuery(insert);
 					if (r.GetID() > 0)
 						obj->id = r.GetID();
@@ -148,6 +189,34 @@ class DBSQL : public Module, public Pipe
 		}
 
 		this->updated_items.clear();
+
+		if (!batches.empty())
+		{
+			/* Write all of the updates in one transaction, with as few queries as possible */
+			this->RunImport(Query("BEGIN"));
+
+			for (std::map<Anope::string, std::map<unsigned int, Data *> >::iterator it = batches.begin(), it_end = batches.end(); it != it_end; ++it)
+			{
+				std::map<unsigned int, Data *> rows;
+
+				for (std::map<unsigned int, Data *>::iterator rit = it->second.begin(), rit_end = it->second.end(); rit != rit_end;)
+				{
+					rows.insert(*rit);
+
+					if (++rit == rit_end || rows.size() >= std::max(this->batchsize, 1U))
+					{
+						this->RunImport(this->sql->BuildInsert(it->first, rows));
+						rows.clear();
+					}
+				}
+
+				for (std::map<unsigned int, Data *>::iterator rit = it->second.begin(), rit_end = it->second.end(); rit != rit_end; ++rit)
+					delete rit->second;
+			}
+
+			this->RunImport(Query("COMMIT"));
+		}
+
 		this->imported = true;
 	}
 
@@ -157,6 +226,14 @@ class DBSQL : public Module, public Pipe
 		this->sql = ServiceReference<Provider>("SQL::Provider", block->Get<const Anope::string>("engine"));
 		this->prefix = block->Get<const Anope::string>("prefix", "anope_db_");
 		this->import = block->Get<bool>("import");
+		this->batchsize = block->Get<unsigned>("batchsize", "100");
+
+		time_t flushinterval = block->Get<time_t>("flushinterval");
+		if (!this->flush_timer || this->flush_timer->GetSecs() != flushinterval)
+		{
+			delete this->flush_timer;
+			this->flush_timer = flushinterval > 0 ? new FlushTimer(this, flushinterval) : NULL;
+		}
 	}
 
 	void OnShutdown() anope_override
@@ -199,7 +276,8 @@ class DBSQL : public Module, public Pipe
 			return;
 		obj->UpdateTS();
 		this->updated_items.insert(obj);
-		this->Notify();
+		if (!this->flush_timer)
+			this->Notify();
 	}
 
 	void OnSerializableDestruct(Serializable *obj) anope_override
@@ -208,7 +286,11 @@ class DBSQL : public Module, public Pipe
 			return;
 		Serialize::Type *s_type = obj->GetSerializableType();
 		if (s_type && obj->id > 0)
-			this->RunBackground("DELETE FROM `" + this->prefix + s_type->GetName() + "` WHERE `id` = " + stringify(obj->id));
+		{
+			Query query("DELETE FROM `" + this->prefix + s_type->GetName() + "` WHERE `id` = @id@", "delete " + this->prefix + s_type->GetName());
+			query.SetValue("id", obj->id);
+			this->RunBackground(query);
+		}
 		this->updated_items.erase(obj);
 	}
 
@@ -220,7 +302,8 @@ class DBSQL : public Module, public Pipe
 			return; /* object is pending creation */
 		obj->UpdateTS();
 		this->updated_items.insert(obj);
-		this->Notify();
+		if (!this->flush_timer)
+			this->Notify();
 	}
 
 	void OnSerializeTypeCreate(Serialize::Type *sb) anope_override
@@ -265,4 +348,9 @@ class DBSQL : public Module, public Pipe
 	}
 };
 
+void FlushTimer::Tick(time_t)
+{
+	db->OnNotify();
+}
+
 MODULE_INIT(DBSQL)
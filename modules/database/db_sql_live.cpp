@@ -11,6 +11,54 @@
 
 using namespace SQL;
 
+class DBMySQL;
+static DBMySQL *me;
+
+class SQLLiveInterface : public Interface
+{
+ public:
+	SQLLiveInterface(Module *o) : Interface(o) { }
+
+	void OnResult(const Result &r) anope_override
+	{
+		Log(LOG_DEBUG) << "SQL-live got " << r.Rows() << " rows for " << r.finished_query;
+	}
+
+	void OnError(const Result &r) anope_override
+	{
+		Log(LOG_DEBUG) << "SQL-live got error " << r.GetError() << " for " + r.finished_query;
+	}
+};
+
+/** Receives the changes to a type found by polling. There is one for each type,
+ * which lives as long as the module, as the SQL provider may drop queued queries
+ * without telling us.
+ */
+class PollInterface : public SQLLiveInterface
+{
+	Anope::string type;
+
+ public:
+	/* The time the poll in progress fetches changes since */
+	time_t since;
+
+	PollInterface(Module *o, const Anope::string &t) : SQLLiveInterface(o), type(t), since(0) { }
+
+	void OnResult(const Result &r) anope_override;
+
+	void OnError(const Result &r) anope_override;
+};
+
+/** Polls every type for changes, if a poll interval is configured
+ */
+class PollTimer : public Timer
+{
+ public:
+	PollTimer(long timeout) : Timer(timeout, Anope::CurTime, true) { }
+
+	void Tick(time_t) anope_override;
+};
+
 class DBMySQL : public Module, public Pipe
 {
  private:
@@ -20,6 +68,19 @@ class DBMySQL : public Module, public Pipe
 	bool ro;
 	bool init;
 	std::set<Serializable *> updated_items;
+	SQLLiveInterface sqlinterface;
+	PollTimer *poll_timer;
+	/* Types with a poll in progress */
+	std::set<Anope::string> polling;
+	std::map<Anope::string, PollInterface *> poll_interfaces;
+	/* Ids of the types with a poll in progress which have been written or deleted
+	 * since the poll was sent, so the rows it returns for them are out of date
+	 */
+	std::map<Anope::string, std::set<uint64_t> > written;
+	/* Types whose next poll must fetch changes since an earlier time, as the
+	 * last poll did not apply all of them
+	 */
+	std::map<Anope::string, time_t> refetch;
 
 	bool CheckSQL()
 	{
@@ -72,8 +133,10 @@ class DBMySQL : public Module, public Pipe
 	}
 
  public:
-	DBMySQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), SQL("", "")
+	DBMySQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), SQL("", ""), sqlinterface(this), poll_timer(NULL)
 	{
+		me = this;
+
 		this->lastwarn = 0;
 		this->ro = false;
 		this->init = false;
@@ -83,6 +146,22 @@ class DBMySQL : public Module, public Pipe
 			throw ModuleException("If db_sql_live is loaded it must be the first database module loaded.");
 	}
 
+	~DBMySQL()
+	{
+		delete this->poll_timer;
+
+		for (std::map<Anope::string, PollInterface *>::iterator it = this->poll_interfaces.begin(), it_end = this->poll_interfaces.end(); it != it_end; ++it)
+			delete it->second;
+	}
+
+	/** Marks an object as written locally, so a poll in progress does not overwrite it
+	 */
+	void Written(Serialize::Type *s_type, uint64_t id)
+	{
+		if (this->polling.count(s_type->GetName()))
+			this->written[s_type->GetName()].insert(id);
+	}
+
 	void OnNotify() anope_override
 	{
 		if (!this->CheckInit())
@@ -117,6 +196,8 @@ class DBMySQL : public Module, public Pipe
 					obj->id = res.GetID();
 					s_type->objects[obj->id] = obj;
 				}
+
+				this->Written(s_type, obj->id);
 			}
 		}
 
@@ -144,6 +225,13 @@ class DBMySQL : public Module, public Pipe
 		Configuration::Block *block = conf->GetModule(this);
 		this->SQL = ServiceReference<Provider>("SQL::Provider", block->Get<const Anope::string>("engine"));
 		this->prefix = block->Get<const Anope::string>("prefix", "anope_db_");
+
+		time_t pollinterval = block->Get<time_t>("pollinterval");
+		if (!this->poll_timer || this->poll_timer->GetSecs() != pollinterval)
+		{
+			delete this->poll_timer;
+			this->poll_timer = pollinterval > 0 ? new PollTimer(pollinterval) : NULL;
+		}
 	}
 
 	void OnSerializableConstruct(Serializable *obj) anope_override
@@ -163,23 +251,109 @@ class DBMySQL : public Module, public Pipe
 		if (s_type)
 		{
 			if (obj->id > 0)
-				this->RunQuery("DELETE FROM `" + this->prefix + s_type->GetName() + "` WHERE `id` = " + stringify(obj->id));
+			{
+				Query query("DELETE FROM `" + this->prefix + s_type->GetName() + "` WHERE `id` = @id@", "delete " + this->prefix + s_type->GetName());
+				query.SetValue("id", obj->id);
+				this->RunQuery(query);
+
+				this->Written(s_type, obj->id);
+			}
 			s_type->objects.erase(obj->id);
 		}
 		this->updated_items.erase(obj);
 	}
 
+	void OnModuleUnload(User *, Module *m) anope_override
+	{
+		/* Polls queued on an engine which is going away will never finish */
+		if (this->SQL && this->SQL->owner == m)
+		{
+			this->polling.clear();
+			this->written.clear();
+		}
+	}
+
 	void OnSerializeCheck(Serialize::Type *obj) anope_override
 	{
-		if (!this->CheckInit() || obj->GetTimestamp() == Anope::CurTime)
+		/* When polling, changes are applied as they arrive instead */
+		if (this->poll_timer || !this->CheckInit() || obj->GetTimestamp() == Anope::CurTime)
 			return;
 
-		Query query("SELECT * FROM `" + this->prefix + obj->GetName() + "` WHERE (`timestamp` >= " + this->SQL->FromUnixtime(obj->GetTimestamp()) + " OR `timestamp` IS NULL)");
+		Query query = this->BuildCheck(obj, obj->GetTimestamp());
 
 		obj->UpdateTimestamp();
 
 		Result res = this->RunQueryResult(query);
+		this->ProcessCheck(obj, res);
+	}
+
+	/** Asynchronously fetches the changes to every type which does not already have a fetch in progress
+	 */
+	void Poll()
+	{
+		if (!this->CheckInit())
+			return;
 
+		for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
+		{
+			Serialize::Type *obj = it->second;
+
+			if (this->polling.count(obj->GetName()))
+				continue;
+
+			time_t since = obj->GetTimestamp();
+			std::map<Anope::string, time_t>::iterator rit = this->refetch.find(obj->GetName());
+			if (rit != this->refetch.end())
+			{
+				since = std::min(since, rit->second);
+				this->refetch.erase(rit);
+			}
+
+			Query query = this->BuildCheck(obj, since);
+
+			obj->UpdateTimestamp();
+
+			PollInterface *&pi = this->poll_interfaces[obj->GetName()];
+			if (!pi)
+				pi = new PollInterface(this, obj->GetName());
+			pi->since = since;
+
+			this->polling.insert(obj->GetName());
+			this->SQL->Run(pi, query);
+		}
+	}
+
+	void OnPollResult(const Anope::string &tname, time_t since, const Result *res)
+	{
+		this->polling.erase(tname);
+
+		std::set<uint64_t> skip;
+		std::map<Anope::string, std::set<uint64_t> >::iterator it = this->written.find(tname);
+		if (it != this->written.end())
+		{
+			skip.swap(it->second);
+			this->written.erase(it);
+		}
+
+		/* Rows we skipped may also hide newer changes made elsewhere, so look at them again next time */
+		if (!res || !skip.empty())
+			this->refetch[tname] = since;
+
+		Serialize::Type *obj = Serialize::Type::Find(tname);
+		if (res && obj && this->CheckInit())
+			this->ProcessCheck(obj, *res, &skip);
+	}
+
+	Query BuildCheck(Serialize::Type *obj, time_t since)
+	{
+		return Query("SELECT * FROM `" + this->prefix + obj->GetName() + "` WHERE (`timestamp` >= " + this->SQL->FromUnixtime(since) + " OR `timestamp` IS NULL)");
+	}
+
+	/** Applies the changes to a type found by a check
+	 * @param skip Ids whose rows are older than our own copy, if any
+	 */
+	void ProcessCheck(Serialize::Type *obj, const Result &res, const std::set<uint64_t> *skip = NULL)
+	{
 		bool clear_null = false;
 		for (int i = 0; i < res.Rows(); ++i)
 		{
@@ -196,6 +370,9 @@ class DBMySQL : public Module, public Pipe
 				continue;
 			}
 
+			if (skip && skip->count(id))
+				continue;
+
 			if (res.Get(i, "timestamp").empty())
 			{
 				clear_null = true;
@@ -237,7 +414,7 @@ class DBMySQL : public Module, public Pipe
 				else
 				{
 					if (!s)
-						this->RunQuery("UPDATE `" + prefix + obj->GetName() + "` SET `timestamp` = " + this->SQL->FromUnixtime(obj->GetTimestamp()) + " WHERE `id` = " + stringify(id));
+						this->RunCheckQuery("UPDATE `" + prefix + obj->GetName() + "` SET `timestamp` = " + this->SQL->FromUnixtime(obj->GetTimestamp()) + " WHERE `id` = " + stringify(id));
 					else
 						delete s;
 				}
@@ -245,10 +422,16 @@ class DBMySQL : public Module, public Pipe
 		}
 
 		if (clear_null)
-		{
-			query = "DELETE FROM `" + this->prefix + obj->GetName() + "` WHERE `timestamp` IS NULL";
+			this->RunCheckQuery("DELETE FROM `" + this->prefix + obj->GetName() + "` WHERE `timestamp` IS NULL");
+	}
+
+	/* Queries made while applying changes must not block either if we are polling */
+	void RunCheckQuery(const Query &query)
+	{
+		if (this->poll_timer && this->CheckSQL())
+			this->SQL->Run(&this->sqlinterface, query);
+		else
 			this->RunQuery(query);
-		}
 	}
 
 	void OnSerializableUpdate(Serializable *obj) anope_override
@@ -261,4 +444,21 @@ class DBMySQL : public Module, public Pipe
 	}
 };
 
+void PollInterface::OnResult(const Result &r)
+{
+	SQLLiveInterface::OnResult(r);
+	me->OnPollResult(this->type, this->since, &r);
+}
+
+void PollInterface::OnError(const Result &r)
+{
+	SQLLiveInterface::OnError(r);
+	me->OnPollResult(this->type, this->since, NULL);
+}
+
+void PollTimer::Tick(time_t)
+{
+	me->Poll();
+}
+
 MODULE_INIT(DBMySQL)
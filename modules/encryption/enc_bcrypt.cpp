@@ -842,6 +842,66 @@ char *_crypt_gensalt_blowfish_rn(const char *prefix, unsigned long count,
 #include "module.h"
 #include "modules/encryption.h"
 
+static Anope::string Generate(const Anope::string& data, const Anope::string& salt)
+{
+	char hash[64];
+	_crypt_blowfish_rn(data.c_str(), salt.c_str(), hash, sizeof(hash));
+	return hash;
+}
+
+static bool Compare(const Anope::string& string, const Anope::string& hash)
+{
+	Anope::string ret = Generate(string, hash);
+	if (ret.empty())
+		return false;
+
+	return (ret == hash);
+}
+
+/* Checks a password against an account's hash in a worker thread */
+class BCryptCheck : public Task
+{
+	IdentifyRequest *req;
+	/* Copies of the password and the hash it is checked against */
+	Anope::string password, pass;
+	/* If set the password is rehashed with this salt once it matches */
+	Anope::string salt;
+
+	bool matched;
+	Anope::string rehashed;
+
+ public:
+	BCryptCheck(Module *o, IdentifyRequest *r, const Anope::string &p, const Anope::string &s) : Task(o), req(r), password(r->GetPassword()), pass(p), salt(s), matched(false)
+	{
+		req->Hold(owner);
+	}
+
+	void Run() anope_override
+	{
+		matched = Compare(password, pass.substr(7));
+		if (matched && !salt.empty())
+			rehashed = "bcrypt:" + Generate(password, salt);
+	}
+
+	void OnComplete() anope_override
+	{
+		NickAlias *na = NickAlias::Find(req->GetAccount());
+		/* The password may have changed while it was being checked */
+		if (matched && na && na->nc->pass.equals_cs(pass))
+		{
+			/* if we are NOT the first module in the list,
+			 * we want to re-encrypt the pass with the new encryption
+			 */
+			if (ModuleManager::FindFirstOf(ENCRYPTION) != owner)
+				Anope::Encrypt(password, na->nc->pass);
+			else if (!rehashed.empty())
+				na->nc->pass = rehashed;
+			req->Success(owner);
+		}
+		req->Release(owner);
+	}
+};
+
 class EBCRYPT : public Module
 {
 	unsigned int rounds;
@@ -858,22 +918,6 @@ class EBCRYPT : public Module
 		return salt;
 	}
 
-	Anope::string Generate(const Anope::string& data, const Anope::string& salt)
-	{
-		char hash[64];
-		_crypt_blowfish_rn(data.c_str(), salt.c_str(), hash, sizeof(hash));
-		return hash;
-	}
-
-	bool Compare(const Anope::string& string, const Anope::string& hash)
-	{
-		Anope::string ret = Generate(string, hash);
-		if (ret.empty())
-			return false;
-
-		return (ret == hash);
-	}
-
  public:
 	EBCRYPT(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, ENCRYPTION | VENDOR),
 		rounds(10)
@@ -909,30 +953,26 @@ class EBCRYPT : public Module
 		if (hash_method != "bcrypt")
 			return;
 
-		if (Compare(req->GetPassword(), nc->pass.substr(7)))
+		unsigned int hashrounds = 0;
+		try
 		{
-			/* if we are NOT the first module in the list,
-			 * we want to re-encrypt the pass with the new encryption
-			 */
+			size_t roundspos = nc->pass.find('$', 11);
+			if (roundspos == Anope::string::npos)
+				throw ConvertException("Could not find hashrounds");
 
-			unsigned int hashrounds = 0;
-			try
-			{
-				size_t roundspos = nc->pass.find('$', 11);
-				if (roundspos == Anope::string::npos)
-					throw ConvertException("Could not find hashrounds");
+			hashrounds = convertTo<unsigned int>(nc->pass.substr(11, roundspos - 11));
+		}
+		catch (const ConvertException &)
+		{
+			Log(this) << "Could not get the round size of a hash. This is probably a bug. Hash: " << nc->pass;
+		}
 
-				hashrounds = convertTo<unsigned int>(nc->pass.substr(11, roundspos - 11));
-			}
-			catch (const ConvertException &)
-			{
-				Log(this) << "Could not get the round size of a hash. This is probably a bug. Hash: " << nc->pass;
-			}
+		/* The salt is made here as rand() is not safe to use from the worker */
+		Anope::string salt;
+		if (hashrounds && hashrounds != rounds)
+			salt = Salt();
 
-			if (ModuleManager::FindFirstOf(ENCRYPTION) != this || (hashrounds && hashrounds != rounds))
-				Anope::Encrypt(req->GetPassword(), nc->pass);
-			req->Success(this);
-		}
+		WorkerPool::Queue(new BCryptCheck(this, req, nc->pass, salt));
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -105,6 +105,20 @@ class MySQLResult : public Result
 	}
 };
 
+/** A prepared statement
+ */
+struct PreparedStatement
+{
+	/* The text the statement was prepared from */
+	Anope::string text;
+	/* NULL if the query can not be executed as a prepared statement */
+	MYSQL_STMT *stmt;
+	/* Position in the list of recently used statements */
+	std::list<Anope::string>::iterator lru;
+
+	PreparedStatement() : stmt(NULL) { }
+};
+
 /** A MySQL connection, there can be multiple
  */
 class MySQLService : public Provider
@@ -119,11 +133,27 @@ class MySQLService : public Provider
 
 	MYSQL *sql;
 
+	/* Prepared statements, by query key */
+	std::map<Anope::string, PreparedStatement> statements;
+	/* Keys of the prepared statements, most recently used first */
+	std::list<Anope::string> statements_lru;
+
 	/** Escape a query.
 	 * Note the mutex must be held!
 	 */
 	Anope::string Escape(const Anope::string &query);
 
+	/** Get the prepared statement for a query with a key, preparing it if required.
+	 * Only queries which do not return a result set are prepared.
+	 * Note the mutex must be held!
+	 */
+	MYSQL_STMT *Prepare(const Query &query, const Anope::string &real_query);
+
+	/** Close all of the prepared statements, they are lost when the connection is.
+	 * Note the mutex must be held!
+	 */
+	void ClearStatements();
+
  public:
 	/* Locked by the SQL thread when a query is pending on this database,
 	 * prevents us from deleting a connection while a query is executing
@@ -143,6 +173,8 @@ class MySQLService : public Provider
 
 	Query BuildInsert(const Anope::string &table, unsigned int id, Data &data) anope_override;
 
+	Query BuildInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows) anope_override;
+
 	Query GetTables(const Anope::string &prefix) anope_override;
 
 	void Connect();
@@ -309,6 +341,7 @@ MySQLService::~MySQLService()
 {
 	me->DThread->Lock();
 	this->Lock.Lock();
+	this->ClearStatements();
 	mysql_close(this->sql);
 	this->sql = NULL;
 
@@ -335,10 +368,116 @@ void MySQLService::Run(Interface *i, const Query &query)
 	me->DThread->Wakeup();
 }
 
+MYSQL_STMT *MySQLService::Prepare(const Query &query, const Anope::string &real_query)
+{
+	std::map<Anope::string, PreparedStatement>::iterator it = this->statements.find(query.key);
+	if (it != this->statements.end() && it->second.text == real_query)
+	{
+		this->statements_lru.splice(this->statements_lru.begin(), this->statements_lru, it->second.lru);
+		return it->second.stmt;
+	}
+
+	if (it != this->statements.end())
+	{
+		/* The shape of the query has changed, eg a column was added */
+		if (it->second.stmt)
+			mysql_stmt_close(it->second.stmt);
+		this->statements_lru.erase(it->second.lru);
+		this->statements.erase(it);
+	}
+
+	MYSQL_STMT *stmt = mysql_stmt_init(this->sql);
+	if (stmt && mysql_stmt_prepare(stmt, real_query.c_str(), real_query.length()))
+	{
+		mysql_stmt_close(stmt);
+		stmt = NULL;
+	}
+
+	if (stmt)
+	{
+		MYSQL_RES *meta = mysql_stmt_result_metadata(stmt);
+		if (meta)
+		{
+			/* Fetching result sets is left to the text protocol */
+			mysql_free_result(meta);
+			mysql_stmt_close(stmt);
+			stmt = NULL;
+		}
+	}
+
+	PreparedStatement &ps = this->statements[query.key];
+	ps.text = real_query;
+	ps.stmt = stmt;
+	this->statements_lru.push_front(query.key);
+	ps.lru = this->statements_lru.begin();
+
+	if (this->statements_lru.size() > 64)
+	{
+		PreparedStatement &old = this->statements[this->statements_lru.back()];
+		if (old.stmt)
+			mysql_stmt_close(old.stmt);
+		this->statements.erase(this->statements_lru.back());
+		this->statements_lru.pop_back();
+	}
+
+	return stmt;
+}
+
+void MySQLService::ClearStatements()
+{
+	for (std::map<Anope::string, PreparedStatement>::iterator it = this->statements.begin(); it != this->statements.end(); ++it)
+		if (it->second.stmt)
+			mysql_stmt_close(it->second.stmt);
+	this->statements.clear();
+	this->statements_lru.clear();
+}
+
 Result MySQLService::RunQuery(const Query &query)
 {
 	this->Lock.Lock();
 
+	if (!query.key.empty() && this->CheckConnection())
+	{
+		Anope::string real_query;
+		std::vector<const Anope::string *> values;
+		query.Prepare(real_query, values);
+
+		MYSQL_STMT *stmt = this->Prepare(query, real_query);
+		if (stmt)
+		{
+			std::vector<MYSQL_BIND> binds(values.size());
+			std::vector<unsigned long> lengths(values.size());
+			if (!binds.empty())
+				memset(&binds[0], 0, binds.size() * sizeof(MYSQL_BIND));
+
+			for (unsigned i = 0; i < values.size(); ++i)
+			{
+				if (!values[i])
+				{
+					binds[i].buffer_type = MYSQL_TYPE_NULL;
+					continue;
+				}
+
+				lengths[i] = values[i]->length();
+				binds[i].buffer_type = MYSQL_TYPE_STRING;
+				binds[i].buffer = const_cast<char *>(values[i]->c_str());
+				binds[i].buffer_length = lengths[i];
+				binds[i].length = &lengths[i];
+			}
+
+			if ((binds.empty() || !mysql_stmt_bind_param(stmt, &binds[0])) && !mysql_stmt_execute(stmt))
+			{
+				unsigned int id = mysql_stmt_insert_id(stmt);
+				this->Lock.Unlock();
+				return MySQLResult(id, query, real_query, NULL);
+			}
+
+			Anope::string error = mysql_stmt_error(stmt);
+			this->Lock.Unlock();
+			return MySQLResult(query, real_query, error);
+		}
+	}
+
 	Anope::string real_query = this->BuildQuery(query);
 
 	if (this->CheckConnection() && !mysql_real_query(this->sql, real_query.c_str(), real_query.length()))
@@ -433,7 +572,7 @@ Query MySQLService::BuildInsert(const Anope::string &table, unsigned int id, Dat
 	Anope::string query_text = "INSERT INTO `" + table + "` (`id`";
 	for (Data::Map::const_iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
 		query_text += ",`" + it->first + "`";
-	query_text += ") VALUES (" + stringify(id);
+	query_text += ") VALUES (@id@";
 	for (Data::Map::const_iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
 		query_text += ",@" + it->first + "@";
 	query_text += ") ON DUPLICATE KEY UPDATE ";
@@ -441,7 +580,8 @@ Query MySQLService::BuildInsert(const Anope::string &table, unsigned int id, Dat
 		query_text += "`" + it->first + "`=VALUES(`" + it->first + "`),";
 	query_text.erase(query_text.end() - 1);
 
-	Query query(query_text);
+	Query query(query_text, "insert " + table);
+	query.SetValue("id", id);
 	for (Data::Map::const_iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
 	{
 		Anope::string buf;
@@ -460,6 +600,70 @@ Query MySQLService::BuildInsert(const Anope::string &table, unsigned int id, Dat
 	return query;
 }
 
+Query MySQLService::BuildInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows)
+{
+	/* Every row needs the same columns, so empty the columns missing from any of them */
+	std::set<Anope::string> columns;
+	const std::set<Anope::string> &known_cols = this->active_schema[table];
+	for (std::set<Anope::string>::iterator it = known_cols.begin(), it_end = known_cols.end(); it != it_end; ++it)
+		if (*it != "id" && *it != "timestamp")
+			columns.insert(*it);
+	for (std::map<unsigned int, Data *>::const_iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+		for (Data::Map::const_iterator dit = it->second->data.begin(), dit_end = it->second->data.end(); dit != dit_end; ++dit)
+			columns.insert(dit->first);
+
+	Anope::string query_text = "INSERT INTO `" + table + "` (`id`";
+	for (std::set<Anope::string>::iterator it = columns.begin(), it_end = columns.end(); it != it_end; ++it)
+		query_text += ",`" + *it + "`";
+	query_text += ") VALUES ";
+
+	Query query;
+	unsigned row = 0;
+	for (std::map<unsigned int, Data *>::const_iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it, ++row)
+	{
+		const Anope::string &prefix = stringify(row) + ":";
+
+		if (row)
+			query_text += ",";
+		query_text += "(@" + prefix + "id@";
+		query.SetValue(prefix + "id", it->first);
+
+		for (std::set<Anope::string>::iterator cit = columns.begin(), cit_end = columns.end(); cit != cit_end; ++cit)
+		{
+			query_text += ",@" + prefix + *cit + "@";
+
+			Anope::string buf;
+			Data::Map::const_iterator dit = it->second->data.find(*cit);
+			if (dit != it->second->data.end())
+				*dit->second >> buf;
+
+			bool escape = true;
+			if (buf.empty())
+			{
+				buf = "NULL";
+				escape = false;
+			}
+
+			query.SetValue(prefix + *cit, buf, escape);
+		}
+
+		query_text += ")";
+	}
+
+	query_text += " ON DUPLICATE KEY UPDATE ";
+	for (std::set<Anope::string>::iterator it = columns.begin(), it_end = columns.end(); it != it_end; ++it)
+		query_text += "`" + *it + "`=VALUES(`" + *it + "`),";
+	query_text.erase(query_text.end() - 1);
+
+	query.query = query_text;
+
+	/* Too many parameters to bind, leave it to the text query */
+	if (rows.size() * (columns.size() + 1) <= 65535)
+		query.key = "insert " + table + " " + stringify(rows.size());
+
+	return query;
+}
+
 Query MySQLService::GetTables(const Anope::string &prefix)
 {
 	return Query("SHOW TABLES LIKE '" + prefix + "%';");
@@ -467,6 +671,7 @@ Query MySQLService::GetTables(const Anope::string &prefix)
 
 void MySQLService::Connect()
 {
+	this->ClearStatements();
 	this->sql = mysql_init(this->sql);
 
 	const unsigned int timeout = 1;
@@ -15,7 +15,41 @@
 
 using namespace SQL;
 
-/* SQLite3 API, based from InspIRCd */
+/* SQLite3 API, based from InspIRCd
+ *
+ * Like m_mysql, this module spawns a single thread that is used to execute queries
+ * requested through Run(), so that slow queries do not block the main thread. Results
+ * are queued for the main thread, which is notified through Pipe when they are ready
+ * to be sent back to the modules requesting them. RunQuery() still executes queries
+ * synchronously for callers that need the result immediately.
+ */
+
+class SQLiteService;
+
+/** A query request
+ */
+struct QueryRequest
+{
+	/* The database to run the query on */
+	SQLiteService *service;
+	/* The interface to use once we have the result to send the data back */
+	Interface *sqlinterface;
+	/* The actual query */
+	Query query;
+
+	QueryRequest(SQLiteService *s, Interface *i, const Query &q) : service(s), sqlinterface(i), query(q) { }
+};
+
+/** A query result */
+struct QueryResult
+{
+	/* The interface to send the data back on */
+	Interface *sqlinterface;
+	/* The result */
+	Result result;
+
+	QueryResult(Interface *i, Result &r) : sqlinterface(i), result(r) { }
+};
 
 /** A SQLite result
  */
@@ -36,6 +70,19 @@ class SQLiteResult : public Result
 	}
 };
 
+/** A prepared statement
+ */
+struct PreparedStatement
+{
+	/* The text the statement was prepared from */
+	Anope::string text;
+	sqlite3_stmt *stmt;
+	/* Position in the list of recently used statements */
+	std::list<Anope::string>::iterator lru;
+
+	PreparedStatement() : stmt(NULL) { }
+};
+
 /** A SQLite database, there can be multiple
  */
 class SQLiteService : public Provider
@@ -46,35 +93,77 @@ class SQLiteService : public Provider
 
 	sqlite3 *sql;
 
+	/* Prepared statements, by query key */
+	std::map<Anope::string, PreparedStatement> statements;
+	/* Keys of the prepared statements, most recently used first */
+	std::list<Anope::string> statements_lru;
+
 	Anope::string Escape(const Anope::string &query);
 
+	/** Get the prepared statement for a query with a key, preparing it if required,
+	 * and bind its parameters.
+	 * Note the mutex must be held!
+	 */
+	sqlite3_stmt *Prepare(const Query &query, Anope::string &real_query);
+
  public:
+	/* Locked while a query is executing on this database, prevents the
+	 * main thread and the SQL thread from using the connection at once
+	 * and us from closing it while a query is executing in the thread
+	 */
+	Mutex Lock;
+
 	SQLiteService(Module *o, const Anope::string &n, const Anope::string &d);
 
 	~SQLiteService();
 
 	void Run(Interface *i, const Query &query) anope_override;
 
-	Result RunQuery(const Query &query);
+	Result RunQuery(const Query &query) anope_override;
 
 	std::vector<Query> CreateTable(const Anope::string &table, const Data &data) anope_override;
 
-	Query BuildInsert(const Anope::string &table, unsigned int id, Data &data);
+	Query BuildInsert(const Anope::string &table, unsigned int id, Data &data) anope_override;
+
+	Query BuildInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows) anope_override;
 
-	Query GetTables(const Anope::string &prefix);
+	Query GetTables(const Anope::string &prefix) anope_override;
 
 	Anope::string BuildQuery(const Query &q);
 
 	Anope::string FromUnixtime(time_t);
 };
 
-class ModuleSQLite : public Module
+/** The SQL thread used to execute queries
+ */
+class DispatcherThread : public Thread, public Condition
+{
+ public:
+	DispatcherThread() : Thread() { }
+
+	void Run() anope_override;
+};
+
+class ModuleSQLite;
+static ModuleSQLite *me;
+class ModuleSQLite : public Module, public Pipe
 {
 	/* SQL connections */
 	std::map<Anope::string, SQLiteService *> SQLiteServices;
  public:
+	/* Pending query requests */
+	std::deque<QueryRequest> QueryRequests;
+	/* Pending finished requests with results */
+	std::deque<QueryResult> FinishedRequests;
+	/* The thread used to execute queries */
+	DispatcherThread *DThread;
+
 	ModuleSQLite(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, EXTRA | VENDOR)
 	{
+		me = this;
+
+		DThread = new DispatcherThread();
+		DThread->Start();
 	}
 
 	~ModuleSQLite()
@@ -82,6 +171,11 @@ class ModuleSQLite : public Module
 		for (std::map<Anope::string, SQLiteService *>::iterator it = this->SQLiteServices.begin(); it != this->SQLiteServices.end(); ++it)
 			delete it->second;
 		SQLiteServices.clear();
+
+		DThread->SetExitState();
+		DThread->Wakeup();
+		DThread->Join();
+		delete DThread;
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -131,6 +225,52 @@ class ModuleSQLite : public Module
 			}
 		}
 	}
+
+	void OnModuleUnload(User *, Module *m) anope_override
+	{
+		this->DThread->Lock();
+
+		for (unsigned i = this->QueryRequests.size(); i > 0; --i)
+		{
+			QueryRequest &r = this->QueryRequests[i - 1];
+
+			if (r.sqlinterface && r.sqlinterface->owner == m)
+			{
+				if (i == 1)
+				{
+					r.service->Lock.Lock();
+					r.service->Lock.Unlock();
+				}
+
+				this->QueryRequests.erase(this->QueryRequests.begin() + i - 1);
+			}
+		}
+
+		this->DThread->Unlock();
+
+		this->OnNotify();
+	}
+
+	void OnNotify() anope_override
+	{
+		this->DThread->Lock();
+		std::deque<QueryResult> finishedRequests = this->FinishedRequests;
+		this->FinishedRequests.clear();
+		this->DThread->Unlock();
+
+		for (std::deque<QueryResult>::const_iterator it = finishedRequests.begin(), it_end = finishedRequests.end(); it != it_end; ++it)
+		{
+			const QueryResult &qr = *it;
+
+			if (!qr.sqlinterface)
+				throw SQL::Exception("NULL qr.sqlinterface in ModuleSQLite::OnNotify() ?");
+
+			if (qr.result.GetError().empty())
+				qr.sqlinterface->OnResult(qr.result);
+			else
+				qr.sqlinterface->OnError(qr.result);
+		}
+	}
 };
 
 SQLiteService::SQLiteService(Module *o, const Anope::string &n, const Anope::string &d)
@@ -152,26 +292,115 @@ SQLiteService::SQLiteService(Module *o, const Anope::string &n, const Anope::str
 
 SQLiteService::~SQLiteService()
 {
+	me->DThread->Lock();
 	sqlite3_interrupt(this->sql);
+	this->Lock.Lock();
+	for (std::map<Anope::string, PreparedStatement>::iterator it = this->statements.begin(); it != this->statements.end(); ++it)
+		sqlite3_finalize(it->second.stmt);
+	this->statements.clear();
 	sqlite3_close(this->sql);
+	this->sql = NULL;
+
+	for (unsigned i = me->QueryRequests.size(); i > 0; --i)
+	{
+		QueryRequest &r = me->QueryRequests[i - 1];
+
+		if (r.service == this)
+		{
+			if (r.sqlinterface)
+				r.sqlinterface->OnError(Result(0, r.query, "SQL Interface is going away"));
+			me->QueryRequests.erase(me->QueryRequests.begin() + i - 1);
+		}
+	}
+	this->Lock.Unlock();
+	me->DThread->Unlock();
 }
 
 void SQLiteService::Run(Interface *i, const Query &query)
 {
-	Result res = this->RunQuery(query);
-	if (!res.GetError().empty())
-		i->OnError(res);
+	me->DThread->Lock();
+	me->QueryRequests.push_back(QueryRequest(this, i, query));
+	me->DThread->Unlock();
+	me->DThread->Wakeup();
+}
+
+sqlite3_stmt *SQLiteService::Prepare(const Query &query, Anope::string &real_query)
+{
+	std::vector<const Anope::string *> values;
+	query.Prepare(real_query, values);
+
+	PreparedStatement &ps = this->statements[query.key];
+	if (ps.stmt && ps.text == real_query)
+	{
+		this->statements_lru.splice(this->statements_lru.begin(), this->statements_lru, ps.lru);
+	}
 	else
-		i->OnResult(res);
+	{
+		if (ps.stmt)
+		{
+			/* The shape of the query has changed, eg a column was added */
+			sqlite3_finalize(ps.stmt);
+			this->statements_lru.erase(ps.lru);
+		}
+
+		ps.text = real_query;
+		if (sqlite3_prepare_v2(this->sql, real_query.c_str(), real_query.length(), &ps.stmt, NULL) != SQLITE_OK)
+		{
+			this->statements.erase(query.key);
+			return NULL;
+		}
+
+		this->statements_lru.push_front(query.key);
+		ps.lru = this->statements_lru.begin();
+
+		if (this->statements_lru.size() > 64)
+		{
+			PreparedStatement &old = this->statements[this->statements_lru.back()];
+			sqlite3_finalize(old.stmt);
+			this->statements.erase(this->statements_lru.back());
+			this->statements_lru.pop_back();
+		}
+	}
+
+	for (unsigned i = 0; i < values.size(); ++i)
+	{
+		if (values[i])
+			sqlite3_bind_text(ps.stmt, i + 1, values[i]->c_str(), values[i]->length(), SQLITE_STATIC);
+		else
+			sqlite3_bind_null(ps.stmt, i + 1);
+	}
+
+	return ps.stmt;
 }
 
 Result SQLiteService::RunQuery(const Query &query)
 {
-	Anope::string real_query = this->BuildQuery(query);
+	this->Lock.Lock();
+
+	Anope::string real_query;
 	sqlite3_stmt *stmt;
-	int err = sqlite3_prepare_v2(this->sql, real_query.c_str(), real_query.length(), &stmt, NULL);
-	if (err != SQLITE_OK)
-		return SQLiteResult(query, real_query, sqlite3_errmsg(this->sql));
+	bool prepared = !query.key.empty();
+	if (prepared)
+	{
+		stmt = this->Prepare(query, real_query);
+		if (!stmt)
+		{
+			Anope::string error = sqlite3_errmsg(this->sql);
+			this->Lock.Unlock();
+			return SQLiteResult(query, real_query, error);
+		}
+	}
+	else
+	{
+		real_query = this->BuildQuery(query);
+		int err = sqlite3_prepare_v2(this->sql, real_query.c_str(), real_query.length(), &stmt, NULL);
+		if (err != SQLITE_OK)
+		{
+			Anope::string error = sqlite3_errmsg(this->sql);
+			this->Lock.Unlock();
+			return SQLiteResult(query, real_query, error);
+		}
+	}
 
 	std::vector<Anope::string> columns;
 	int cols = sqlite3_column_count(stmt);
@@ -181,6 +410,7 @@ Result SQLiteService::RunQuery(const Query &query)
 
 	SQLiteResult result(0, query, real_query);
 
+	int err;
 	while ((err = sqlite3_step(stmt)) == SQLITE_ROW)
 	{
 		std::map<Anope::string, Anope::string> items;
@@ -195,10 +425,22 @@ Result SQLiteService::RunQuery(const Query &query)
 
 	result.id = sqlite3_last_insert_rowid(this->sql);
 
-	sqlite3_finalize(stmt);
+	Anope::string error;
+	if (err != SQLITE_DONE)
+		error = sqlite3_errmsg(this->sql);
+
+	if (prepared)
+	{
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+	}
+	else
+		sqlite3_finalize(stmt);
+
+	this->Lock.Unlock();
 
 	if (err != SQLITE_DONE)
-		return SQLiteResult(query, real_query, sqlite3_errmsg(this->sql));
+		return SQLiteResult(query, real_query, error);
 
 	return result;
 }
@@ -286,13 +528,15 @@ Query SQLiteService::BuildInsert(const Anope::string &table, unsigned int id, Da
 	query_text.erase(query_text.length() - 1);
 	query_text += ") VALUES (";
 	if (id > 0)
-		query_text += stringify(id) + ",";
+		query_text += "@id@,";
 	for (Data::Map::const_iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
 		query_text += "@" + it->first + "@,";
 	query_text.erase(query_text.length() - 1);
 	query_text += ")";
 
-	Query query(query_text);
+	Query query(query_text, "insert " + table + (id > 0 ? " id" : ""));
+	if (id > 0)
+		query.SetValue("id", id);
 	for (Data::Map::const_iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
 	{
 		Anope::string buf;
@@ -303,6 +547,57 @@ Query SQLiteService::BuildInsert(const Anope::string &table, unsigned int id, Da
 	return query;
 }
 
+Query SQLiteService::BuildInsert(const Anope::string &table, const std::map<unsigned int, Data *> &rows)
+{
+	/* Every row needs the same columns, so empty the columns missing from any of them */
+	std::set<Anope::string> columns;
+	const std::set<Anope::string> &known_cols = this->active_schema[table];
+	for (std::set<Anope::string>::iterator it = known_cols.begin(), it_end = known_cols.end(); it != it_end; ++it)
+		if (*it != "id" && *it != "timestamp")
+			columns.insert(*it);
+	for (std::map<unsigned int, Data *>::const_iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+		for (Data::Map::const_iterator dit = it->second->data.begin(), dit_end = it->second->data.end(); dit != dit_end; ++dit)
+			columns.insert(dit->first);
+
+	Anope::string query_text = "REPLACE INTO `" + table + "` (`id`";
+	for (std::set<Anope::string>::iterator it = columns.begin(), it_end = columns.end(); it != it_end; ++it)
+		query_text += ",`" + *it + "`";
+	query_text += ") VALUES ";
+
+	Query query;
+	unsigned row = 0;
+	for (std::map<unsigned int, Data *>::const_iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it, ++row)
+	{
+		const Anope::string &prefix = stringify(row) + ":";
+
+		if (row)
+			query_text += ",";
+		query_text += "(@" + prefix + "id@";
+		query.SetValue(prefix + "id", it->first);
+
+		for (std::set<Anope::string>::iterator cit = columns.begin(), cit_end = columns.end(); cit != cit_end; ++cit)
+		{
+			query_text += ",@" + prefix + *cit + "@";
+
+			Anope::string buf;
+			Data::Map::const_iterator dit = it->second->data.find(*cit);
+			if (dit != it->second->data.end())
+				*dit->second >> buf;
+			query.SetValue(prefix + *cit, buf);
+		}
+
+		query_text += ")";
+	}
+
+	query.query = query_text;
+
+	/* Too many parameters to bind, leave it to the text query */
+	if (rows.size() * (columns.size() + 1) <= static_cast<unsigned>(sqlite3_limit(this->sql, SQLITE_LIMIT_VARIABLE_NUMBER, -1)))
+		query.key = "insert " + table + " " + stringify(rows.size());
+
+	return query;
+}
+
 Query SQLiteService::GetTables(const Anope::string &prefix)
 {
 	return Query("SELECT name FROM sqlite_master WHERE type='table' AND name LIKE '" + prefix + "%';");
@@ -331,4 +626,36 @@ Anope::string SQLiteService::FromUnixtime(time_t t)
 	return "datetime('" + stringify(t) + "', 'unixepoch')";
 }
 
+void DispatcherThread::Run()
+{
+	this->Lock();
+
+	while (!this->GetExitState())
+	{
+		if (!me->QueryRequests.empty())
+		{
+			QueryRequest &r = me->QueryRequests.front();
+			this->Unlock();
+
+			Result sresult = r.service->RunQuery(r.query);
+
+			this->Lock();
+			if (!me->QueryRequests.empty() && me->QueryRequests.front().query == r.query)
+			{
+				if (r.sqlinterface)
+					me->FinishedRequests.push_back(QueryResult(r.sqlinterface, sresult));
+				me->QueryRequests.pop_front();
+			}
+		}
+		else
+		{
+			if (!me->FinishedRequests.empty())
+				me->Notify();
+			this->Wait();
+		}
+	}
+
+	this->Unlock();
+}
+
 MODULE_INIT(ModuleSQLite)
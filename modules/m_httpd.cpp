@@ -26,6 +26,8 @@ static Anope::string GetStatusFromCode(HTTPError err)
 			return "200 OK";
 		case HTTP_FOUND:
 			return "302 Found";
+		case HTTP_NOT_MODIFIED:
+			return "304 Not Modified";
 		case HTTP_BAD_REQUEST:
 			return "400 Bad Request";
 		case HTTP_PAGE_NOT_FOUND:
@@ -41,11 +43,13 @@ class MyHTTPClient : public HTTPClient
 {
 	HTTPProvider *provider;
 	HTTPMessage message;
-	bool header_done, served;
+	bool header_done;
 	Anope::string page_name;
 	Reference<HTTPPage> page;
 	Anope::string ip;
 
+	/* Data received from the client which has not been parsed yet */
+	Anope::string inbuf;
 	unsigned content_length;
 
 	enum
@@ -55,11 +59,26 @@ class MyHTTPClient : public HTTPClient
 		ACTION_POST
 	} action;
 
+	/* Whether the server allows persistent connections */
+	bool persist;
+	/* Whether the current request was made using HTTP/1.1 */
+	bool http11;
+	/* Whether the connection is kept open after the current request */
+	bool keepalive;
+	/* Whether the current request has been dispatched and is waiting on its reply */
+	bool busy;
+	/* Whether the headers of the current reply have been sent by Flush() */
+	bool streaming;
+	/* Whether Parse() is running */
+	bool parsing;
+	/* Whether the connection is to be closed once all data is written */
+	bool closing;
+	/* Number of requests answered on this connection */
+	unsigned requests;
+
 	void Serve()
 	{
-		if (this->served)
-			return;
-		this->served = true;
+		this->busy = true;
 
 		if (!this->page)
 		{
@@ -91,50 +110,50 @@ class MyHTTPClient : public HTTPClient
 			this->SendReply(&reply);
 	}
 
- public:
-	time_t created;
-
-	MyHTTPClient(HTTPProvider *l, int f, const sockaddrs &a) : Socket(f, l->IsIPv6()), HTTPClient(l, f, a), provider(l), header_done(false), served(false), ip(a.addr()), content_length(0), action(ACTION_NONE), created(Anope::CurTime)
+	/* Answers a request which could not be parsed. As the start of the
+	 * next request can not be found the connection is closed afterwards.
+	 */
+	void Reject(const Anope::string &msg)
 	{
-		Log(LOG_DEBUG, "httpd") << "Accepted connection " << f << " from " << a.addr();
+		this->keepalive = false;
+		this->busy = true;
+		this->SendError(HTTP_BAD_REQUEST, msg);
 	}
 
-	~MyHTTPClient()
+	/* Parses as many requests as possible out of the input buffer. Requests
+	 * are answered in order, so parsing stops while one is waiting on its reply.
+	 */
+	void Parse()
 	{
-		Log(LOG_DEBUG, "httpd") << "Closing connection " << this->GetFD() << " from " << this->ip;
-	}
+		size_t pos = 0;
 
-	/* Close connection once all data is written */
-	bool ProcessWrite() anope_override
-	{
-		return !BinarySocket::ProcessWrite() || this->write_buffer.empty() ? false : true;
-	}
+		this->parsing = true;
 
-	const Anope::string GetIP() anope_override
-	{
-		return this->ip;
-	}
+		while (!this->busy && !this->closing)
+		{
+			if (!this->header_done)
+			{
+				size_t nl = this->inbuf.find('\n', pos);
+				if (nl == Anope::string::npos)
+					break;
 
-	bool Read(const char *buffer, size_t l) anope_override
-	{
-		message.content.append(buffer, l);
+				Anope::string token = this->inbuf.substr(pos, nl - pos).trim();
+				pos = nl + 1;
 
-		for (size_t nl; !this->header_done && (nl = message.content.find('\n')) != Anope::string::npos;)
-		{
-			Anope::string token = message.content.substr(0, nl).trim();
-			message.content = message.content.substr(nl + 1);
+				if (!token.empty())
+					this->Read(token);
+				else if (this->action != ACTION_NONE)
+					this->header_done = true;
 
-			if (token.empty())
-				this->header_done = true;
-			else
-				this->Read(token);
-		}
+				continue;
+			}
 
-		if (!this->header_done)
-			return true;
+			if (this->inbuf.length() - pos < this->content_length)
+				break;
+
+			this->message.content = this->inbuf.substr(pos, this->content_length);
+			pos += this->content_length;
 
-		if (this->message.content.length() >= this->content_length)
-		{
 			sepstream sep(this->message.content, '&');
 			Anope::string token;
 
@@ -150,6 +169,165 @@ class MyHTTPClient : public HTTPClient
 			this->Serve();
 		}
 
+		this->parsing = false;
+
+		if (this->closing)
+			this->inbuf.clear();
+		else
+			this->inbuf.erase(0, pos);
+	}
+
+	/* Called once the reply to the current request has been sent */
+	void Finish()
+	{
+		this->busy = false;
+		this->last_activity = Anope::CurTime;
+		++this->requests;
+
+		if (!this->keepalive)
+		{
+			this->closing = true;
+			return;
+		}
+
+		this->message = HTTPMessage();
+		this->header_done = false;
+		this->page_name.clear();
+		this->page = NULL;
+		this->ip = this->clientaddr.addr();
+		this->content_length = 0;
+		this->action = ACTION_NONE;
+		this->streaming = false;
+
+		/* Replies sent from outside of Parse() resume any pipelined requests */
+		if (!this->parsing)
+			this->Parse();
+	}
+
+	Anope::string BuildHeaders(HTTPReply *msg)
+	{
+		Anope::string buf = "HTTP/1.1 " + GetStatusFromCode(msg->error) + "\r\n";
+		buf += "Date: " + BuildDate() + "\r\n";
+		buf += "Server: Anope-" + Anope::VersionShort() + "\r\n";
+		if (msg->content_type.empty())
+			buf += "Content-Type: text/html\r\n";
+		else
+			buf += "Content-Type: " + msg->content_type + "\r\n";
+		/* A 304 reply has no content, and must not claim a length other than that of the full reply */
+		if (this->streaming && this->http11)
+			buf += "Transfer-Encoding: chunked\r\n";
+		else if (!this->streaming && msg->error != HTTP_NOT_MODIFIED)
+			buf += "Content-Length: " + stringify(msg->length) + "\r\n";
+
+		for (unsigned i = 0; i < msg->cookies.size(); ++i)
+		{
+			Anope::string cookie = "Set-Cookie:";
+
+			for (HTTPReply::cookie::iterator it = msg->cookies[i].begin(), it_end = msg->cookies[i].end(); it != it_end; ++it)
+				cookie += " " + it->first + "=" + it->second + ";";
+
+			cookie.erase(cookie.length() - 1);
+
+			buf += cookie + "\r\n";
+		}
+
+		typedef std::map<Anope::string, Anope::string> map;
+		for (map::iterator it = msg->headers.begin(), it_end = msg->headers.end(); it != it_end; ++it)
+			buf += it->first + ": " + it->second + "\r\n";
+
+		if (!this->keepalive)
+			buf += "Connection: Close\r\n";
+		else if (!this->http11)
+			buf += "Connection: Keep-Alive\r\n";
+		buf += "\r\n";
+
+		return buf;
+	}
+
+	/* Writes out the given headers and the content of a reply as one block, so small replies
+	 * are not held back by Nagle's algorithm, and clears the content. If the reply is being
+	 * streamed the content is sent as a chunk, followed by the last chunk if last is set.
+	 */
+	void WriteContent(HTTPReply *msg, const Anope::string &head, bool last)
+	{
+		bool chunk = this->streaming && this->http11;
+		std::string buf;
+
+		buf.reserve(head.length() + msg->length + 32);
+		buf.append(head.c_str(), head.length());
+
+		if (msg->length)
+		{
+			if (chunk)
+			{
+				char size[32];
+				snprintf(size, sizeof(size), "%lx\r\n", static_cast<unsigned long>(msg->length));
+				buf += size;
+			}
+
+			for (unsigned i = 0; i < msg->out.size(); ++i)
+				buf.append(msg->out[i]->buf, msg->out[i]->len);
+
+			if (chunk)
+				buf += "\r\n";
+		}
+
+		if (chunk && last)
+			buf += "0\r\n\r\n";
+
+		if (!buf.empty())
+			this->Write(buf.data(), buf.length());
+
+		for (unsigned i = 0; i < msg->out.size(); ++i)
+			delete msg->out[i];
+		msg->out.clear();
+		msg->length = 0;
+	}
+
+ public:
+	time_t last_activity;
+
+	MyHTTPClient(HTTPProvider *l, int f, const sockaddrs &a, bool p) : Socket(f, l->IsIPv6()), HTTPClient(l, f, a), provider(l), header_done(false), ip(a.addr()), content_length(0), action(ACTION_NONE),
+		persist(p), http11(false), keepalive(false), busy(false), streaming(false), parsing(false), closing(false), requests(0), last_activity(Anope::CurTime)
+	{
+		Log(LOG_DEBUG, "httpd") << "Accepted connection " << f << " from " << a.addr();
+	}
+
+	~MyHTTPClient()
+	{
+		Log(LOG_DEBUG, "httpd") << "Closing connection " << this->GetFD() << " from " << this->ip << " after " << this->requests << " request(s)";
+	}
+
+	/* Close connection once all data is written, unless it is being kept alive */
+	bool ProcessWrite() anope_override
+	{
+		if (!BinarySocket::ProcessWrite())
+			return false;
+		return !this->closing || !this->write_buffer.empty();
+	}
+
+	const Anope::string GetIP() anope_override
+	{
+		return this->ip;
+	}
+
+	/* Whether this connection is waiting for another request after answering one */
+	bool IsIdle() const
+	{
+		return this->requests && !this->busy && this->action == ACTION_NONE && this->inbuf.empty();
+	}
+
+	bool Read(const char *buffer, size_t l) anope_override
+	{
+		if (this->closing)
+			return true;
+
+		if (this->IsIdle())
+			this->last_activity = Anope::CurTime;
+
+		this->inbuf.append(buffer, l);
+		this->Parse();
+
 		return true;
 	}
 
@@ -164,13 +342,13 @@ class MyHTTPClient : public HTTPClient
 
 			if (params.empty() || (params[0] != "GET" && params[0] != "POST"))
 			{
-				this->SendError(HTTP_BAD_REQUEST, "Unknown operation");
+				this->Reject("Unknown operation");
 				return true;
 			}
 
 			if (params.size() != 3)
 			{
-				this->SendError(HTTP_BAD_REQUEST, "Invalid parameters");
+				this->Reject("Invalid parameters");
 				return true;
 			}
 
@@ -179,6 +357,9 @@ class MyHTTPClient : public HTTPClient
 			else if (params[0] == "POST")
 				this->action = ACTION_POST;
 
+			this->http11 = params[2] == "HTTP/1.1";
+			this->keepalive = this->persist && this->http11;
+
 			Anope::string targ = params[1];
 			size_t q = targ.find('?');
 			if (q != Anope::string::npos)
@@ -228,6 +409,20 @@ class MyHTTPClient : public HTTPClient
 			size_t sz = buf.find(':');
 			if (sz + 2 < buf.length())
 				this->message.headers[buf.substr(0, sz)] = buf.substr(sz + 2);
+
+			const Anope::string name = buf.substr(0, sz);
+			if (name.equals_ci("Connection"))
+			{
+				if (buf.find_ci("close", sz) != Anope::string::npos)
+					this->keepalive = false;
+				else if (buf.find_ci("keep-alive", sz) != Anope::string::npos)
+					this->keepalive = this->persist;
+			}
+			else if (name.equals_ci("Transfer-Encoding"))
+			{
+				/* Chunked request bodies are not supported, so where this request ends is unknown */
+				this->keepalive = false;
+			}
 		}
 
 		return true;
@@ -246,72 +441,71 @@ class MyHTTPClient : public HTTPClient
 
 	void SendReply(HTTPReply *msg) anope_override
 	{
-		this->WriteClient("HTTP/1.1 " + GetStatusFromCode(msg->error));
-		this->WriteClient("Date: " + BuildDate());
-		this->WriteClient("Server: Anope-" + Anope::VersionShort());
-		if (msg->content_type.empty())
-			this->WriteClient("Content-Type: text/html");
-		else
-			this->WriteClient("Content-Type: " + msg->content_type);
-		this->WriteClient("Content-Length: " + stringify(msg->length));
-
-		for (unsigned i = 0; i < msg->cookies.size(); ++i)
-		{
-			Anope::string buf = "Set-Cookie:";
-
-			for (HTTPReply::cookie::iterator it = msg->cookies[i].begin(), it_end = msg->cookies[i].end(); it != it_end; ++it)
-				buf += " " + it->first + "=" + it->second + ";";
-
-			buf.erase(buf.length() - 1);
+		/* Only the first reply to a request is sent */
+		if (!this->busy)
+			return;
 
-			this->WriteClient(buf);
-		}
+		if (!this->streaming)
+			this->WriteContent(msg, this->BuildHeaders(msg), true);
+		else
+			this->WriteContent(msg, "", true);
 
-		typedef std::map<Anope::string, Anope::string> map;
-		for (map::iterator it = msg->headers.begin(), it_end = msg->headers.end(); it != it_end; ++it)
-			this->WriteClient(it->first + ": " + it->second);
+		this->Finish();
+	}
 
-		this->WriteClient("Connection: Close");
-		this->WriteClient("");
+	void Flush(HTTPReply *msg) anope_override
+	{
+		if (!this->busy)
+			return;
 
-		for (unsigned i = 0; i < msg->out.size(); ++i)
+		Anope::string head;
+		if (!this->streaming)
 		{
-			HTTPReply::Data* d = msg->out[i];
-
-			this->Write(d->buf, d->len);
-
-			delete d;
+			this->streaming = true;
+			/* HTTP/1.0 clients can not read chunked replies, so the end of the reply is marked by closing the connection */
+			if (!this->http11)
+				this->keepalive = false;
+			head = this->BuildHeaders(msg);
 		}
 
-		msg->out.clear();
+		this->WriteContent(msg, head, false);
 	}
 };
 
 class MyHTTPProvider : public HTTPProvider, public Timer
 {
-	int timeout;
+	int timeout, keepalive;
 	std::map<Anope::string, HTTPPage *> pages;
 	std::list<Reference<MyHTTPClient> > clients;
 
  public:
-	MyHTTPProvider(Module *c, const Anope::string &n, const Anope::string &i, const unsigned short p, const int t, bool s) : Socket(-1, i.find(':') != Anope::string::npos), HTTPProvider(c, n, i, p, s), Timer(c, 10, Anope::CurTime, true), timeout(t) { }
+	MyHTTPProvider(Module *c, const Anope::string &n, const Anope::string &i, const unsigned short p, const int t, const int k, bool s) : Socket(-1, i.find(':') != Anope::string::npos), HTTPProvider(c, n, i, p, s), Timer(c, 5, Anope::CurTime, true), timeout(t), keepalive(k) { }
+
+	void SetTimeouts(int t, int k)
+	{
+		this->timeout = t;
+		this->keepalive = k;
+	}
 
 	void Tick(time_t) anope_override
 	{
-		while (!this->clients.empty())
+		for (std::list<Reference<MyHTTPClient> >::iterator it = this->clients.begin(); it != this->clients.end();)
 		{
-			Reference<MyHTTPClient>& c = this->clients.front();
-			if (c && c->created + this->timeout >= Anope::CurTime)
-				break;
+			Reference<MyHTTPClient> &c = *it;
+			if (c && c->last_activity + (c->IsIdle() ? this->keepalive : this->timeout) >= Anope::CurTime)
+			{
+				++it;
+				continue;
+			}
 
 			delete c;
-			this->clients.pop_front();
+			it = this->clients.erase(it);
 		}
 	}
 
 	ClientSocket* OnAccept(int fd, const sockaddrs &addr) anope_override
 	{
-		MyHTTPClient *c = new MyHTTPClient(this, fd, addr);
+		MyHTTPClient *c = new MyHTTPClient(this, fd, addr, this->keepalive > 0);
 		this->clients.push_back(c);
 		return c;
 	}
@@ -374,6 +568,7 @@ class HTTPD : public Module
 			Anope::string ip = block->Get<const Anope::string>("ip");
 			int port = block->Get<int>("port", "8080");
 			int timeout = block->Get<int>("timeout", "30");
+			int keepalive = block->Get<int>("keepalive", "15");
 			bool ssl = block->Get<bool>("ssl", "no");
 			Anope::string ext_ip = block->Get<const Anope::string>("extforward_ip");
 			Anope::string ext_header = block->Get<const Anope::string>("extforward_header");
@@ -394,7 +589,7 @@ class HTTPD : public Module
 			{
 				try
 				{
-					p = new MyHTTPProvider(this, hname, ip, port, timeout, ssl);
+					p = new MyHTTPProvider(this, hname, ip, port, timeout, keepalive, ssl);
 					if (ssl && sslref)
 						sslref->Init(p);
 				}
@@ -420,7 +615,7 @@ class HTTPD : public Module
 
 					try
 					{
-						p = new MyHTTPProvider(this, hname, ip, port, timeout, ssl);
+						p = new MyHTTPProvider(this, hname, ip, port, timeout, keepalive, ssl);
 						if (ssl && sslref)
 							sslref->Init(p);
 					}
@@ -432,6 +627,8 @@ class HTTPD : public Module
 
 					this->providers[hname] = p;
 				}
+				else
+					p->SetTimeouts(timeout, keepalive);
 			}
 
 
@@ -15,6 +15,11 @@ class MyRedisService;
 
 class RedisSocket : public BinarySocket, public ConnectionSocket
 {
+	/* Data received but not yet parsed, kept between reads */
+	std::vector<char> rbuf;
+	/* The reply currently being parsed */
+	Reply partial;
+
 	size_t ParseReply(Reply &r, const char *buf, size_t l);
  public:
 	MyRedisService *provider;
@@ -29,6 +34,16 @@ class RedisSocket : public BinarySocket, public ConnectionSocket
 	void OnError(const Anope::string &error) anope_override;
 
 	bool Read(const char *buffer, size_t l) anope_override;
+
+	/** Writes out everything queued, ProcessWrite only writes one command at a time
+	 */
+	bool Flush()
+	{
+		while (!this->write_buffer.empty())
+			if (!this->ProcessWrite())
+				return false;
+		return true;
+	}
 };
 
 class Transaction : public Interface
@@ -206,10 +221,13 @@ class MyRedisService : public Provider
  public:
 	bool BlockAndProcess() anope_override
 	{
-		if (!this->sock->ProcessWrite())
-			this->sock->flags[SF_DEAD] = true;
+		/* Send every queued command before waiting so they are pipelined,
+		 * rather than one command per round trip
+		 */
 		this->sock->SetBlocking(true);
-		if (!this->sock->ProcessRead())
+		if (!this->sock->Flush())
+			this->sock->flags[SF_DEAD] = true;
+		else if (!this->sock->ProcessRead())
 			this->sock->flags[SF_DEAD] = true;
 		this->sock->SetBlocking(false);
 		return !this->sock->interfaces.empty();
@@ -296,6 +314,51 @@ void RedisSocket::OnError(const Anope::string &error)
 	Log() << "redis: Error on " << provider->name << (this == this->provider->sub ? " (sub)" : "") << ": " << error;
 }
 
+/* Finds the \r\n ending the line at the start of buffer, or NULL if the line is not all here yet */
+static const char *FindLineEnd(const char *buffer, size_t l)
+{
+	const char *end = buffer + l;
+	for (const char *p = buffer; (p = static_cast<const char *>(memchr(p, '\r', end - p))) != NULL; ++p)
+	{
+		if (p + 1 == end)
+			break;
+		if (p[1] == '\n')
+			return p;
+	}
+	return NULL;
+}
+
+static bool ParseInt(const char *p, const char *end, int64_t &i)
+{
+	bool negative = p != end && *p == '-';
+	if (negative)
+		++p;
+	if (p == end)
+		return false;
+
+	i = 0;
+	for (; p != end; ++p)
+	{
+		if (*p < '0' || *p > '9')
+			return false;
+		i = i * 10 + (*p - '0');
+	}
+
+	if (negative)
+		i = -i;
+	return true;
+}
+
+/* Whether the reply, and every reply nested in it, has been fully parsed */
+static bool IsComplete(const Reply &r)
+{
+	if (r.type != Reply::MULTI_BULK)
+		return r.type != Reply::NOT_PARSED;
+	if (r.multi_bulk_size < 0)
+		return true;
+	return r.multi_bulk.size() == static_cast<unsigned>(r.multi_bulk_size) && (r.multi_bulk.empty() || IsComplete(*r.multi_bulk.back()));
+}
+
 size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 {
 	size_t used = 0;
@@ -303,129 +366,76 @@ size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 	if (!l)
 		return used;
 
-	if (r.type == Reply::MULTI_BULK)
-		goto multi_bulk_cont;
-
-	switch (*buffer)
+	if (r.type != Reply::MULTI_BULK)
 	{
-		case '+':
+		const char *nl = FindLineEnd(buffer, l);
+		if (nl == NULL)
+			return used;
+		used = nl - buffer + 2;
+
+		int64_t i;
+		switch (*buffer)
 		{
-			Anope::string reason(buffer, 1, l - 1);
-			size_t nl = reason.find("\r\n");
-			Log(LOG_DEBUG_2) << "redis: status ok: " << reason.substr(0, nl);
-			if (nl != Anope::string::npos)
-			{
+			case '+':
 				r.type = Reply::OK;
-				used = 1 + nl + 2;
-			}
-			break;
-		}
-		case '-':
-		{
-			Anope::string reason(buffer, 1, l - 1);
-			size_t nl = reason.find("\r\n");
-			Log(LOG_DEBUG) << "redis: status error: " << reason.substr(0, nl);
-			if (nl != Anope::string::npos)
-			{
+				Log(LOG_DEBUG_2) << "redis: status ok: " << Anope::string(buffer + 1, nl - buffer - 1);
+				return used;
+			case '-':
 				r.type = Reply::NOT_OK;
-				used = 1 + nl + 2;
-			}
-			break;
-		}
-		case ':':
-		{
-			Anope::string ibuf(buffer, 1, l - 1);
-			size_t nl = ibuf.find("\r\n");
-			if (nl != Anope::string::npos)
-			{
-				try
+				r.bulk = Anope::string(buffer + 1, nl - buffer - 1);
+				Log(LOG_DEBUG) << "redis: status error: " << r.bulk;
+				return used;
+			case ':':
+				ParseInt(buffer + 1, nl, r.i);
+				r.type = Reply::INT;
+				return used;
+			case '$':
+				if (!ParseInt(buffer + 1, nl, i))
+					return 0;
+				/* A null bulk has no data following it */
+				if (i >= 0)
 				{
-					r.i = convertTo<int64_t>(ibuf.substr(0, nl));
+					if (used + i + 2 > l)
+						return 0;
+					r.bulk = Anope::string(buffer + used, i);
+					used += i + 2;
 				}
-				catch (const ConvertException &) { }
-
-				r.type = Reply::INT;
-				used = 1 + nl + 2;
-			}
-			break;
+				r.type = Reply::BULK;
+				return used;
+			case '*':
+				if (!ParseInt(buffer + 1, nl, i))
+					return 0;
+				r.type = Reply::MULTI_BULK;
+				r.multi_bulk_size = i;
+				break;
+			default:
+				Log(LOG_DEBUG) << "redis: unknown reply " << *buffer;
+				return 0;
 		}
-		case '$':
+	}
+	else if (!r.multi_bulk.empty() && !IsComplete(*r.multi_bulk.back()))
+	{
+		/* Finish the nested multi bulk we ran out of data for last time */
+		Reply *last = r.multi_bulk.back();
+		used += ParseReply(*last, buffer, l);
+		if (!IsComplete(*last))
+			return used;
+	}
+
+	while (static_cast<int>(r.multi_bulk.size()) < r.multi_bulk_size)
+	{
+		Reply *reply = new Reply();
+		size_t u = ParseReply(*reply, buffer + used, l - used);
+		if (!u)
 		{
-			Anope::string reply(buffer + 1, l - 1);
-			/* This assumes one bulk can always fit in our recv buffer */
-			size_t nl = reply.find("\r\n");
-			if (nl != Anope::string::npos)
-			{
-				int len;
-				try
-				{
-					len = convertTo<int>(reply.substr(0, nl));
-					if (len >= 0)
-					{
-						if (1 + nl + 2 + len + 2 <= l)
-						{
-							used = 1 + nl + 2 + len + 2;
-							r.bulk = reply.substr(nl + 2, len);
-							r.type = Reply::BULK;
-						}
-					}
-					else
-					{
-						used = 1 + nl + 2 + 2;
-						r.type = Reply::BULK;
-					}
-				}
-				catch (const ConvertException &) { }
-			}
+			delete reply;
 			break;
 		}
-		multi_bulk_cont:
-		case '*':
-		{
-			if (r.type != Reply::MULTI_BULK)
-			{
-				Anope::string reply(buffer + 1, l - 1);
-				size_t nl = reply.find("\r\n");
-				if (nl != Anope::string::npos)
-				{
-					r.type = Reply::MULTI_BULK;
-					try
-					{
-						r.multi_bulk_size = convertTo<int>(reply.substr(0, nl));
-					}
-					catch (const ConvertException &) { }
-
-					used = 1 + nl + 2;
-				}
-				else
-					break;
-			}
-			else if (r.multi_bulk_size >= 0 && r.multi_bulk.size() == static_cast<unsigned>(r.multi_bulk_size))
-			{
-				/* This multi bulk is already complete, so check the sub bulks */
-				for (unsigned i = 0; i < r.multi_bulk.size(); ++i)
-					if (r.multi_bulk[i]->type == Reply::MULTI_BULK)
-						ParseReply(*r.multi_bulk[i], buffer + used, l - used);
-				break;
-			}
+		r.multi_bulk.push_back(reply);
+		used += u;
 
-			for (int i = r.multi_bulk.size(); i < r.multi_bulk_size; ++i)
-			{
-				Reply *reply = new Reply();
-				size_t u = ParseReply(*reply, buffer + used, l - used);
-				if (!u)
-				{
-					Log(LOG_DEBUG) << "redis: ran out of data to parse";
-					delete reply;
-					break;
-				}
-				r.multi_bulk.push_back(reply);
-				used += u;
-			}
+		if (!IsComplete(*reply))
 			break;
-		}
-		default:
-			Log(LOG_DEBUG) << "redis: unknown reply " << *buffer;
 	}
 
 	return used;
@@ -433,44 +443,36 @@ size_t RedisSocket::ParseReply(Reply &r, const char *buffer, size_t l)
 
 bool RedisSocket::Read(const char *buffer, size_t l)
 {
-	static std::vector<char> save;
-	std::vector<char> copy;
-
-	if (!save.empty())
+	/* Parse straight out of the socket's buffer unless there is data left from last time */
+	if (!rbuf.empty())
 	{
-		std::copy(buffer, buffer + l, std::back_inserter(save));
-
-		copy = save;
-
-		buffer = &copy[0];
-		l = copy.size();
+		rbuf.insert(rbuf.end(), buffer, buffer + l);
+		buffer = &rbuf[0];
+		l = rbuf.size();
 	}
 
+	size_t total = l;
 	while (l)
 	{
-		static Reply r;
+		Reply &r = this->partial;
 
 		size_t used = this->ParseReply(r, buffer, l);
 		if (!used)
-		{
-			Log(LOG_DEBUG) << "redis: used == 0 ?";
-			r.Clear();
+			/* Full result is not here yet */
 			break;
-		}
 		else if (used > l)
 		{
 			Log(LOG_DEBUG) << "redis: used > l ?";
 			r.Clear();
+			l = 0;
 			break;
 		}
 
-		/* Full result is not here yet */
-		if (r.type == Reply::MULTI_BULK && static_cast<unsigned>(r.multi_bulk_size) != r.multi_bulk.size())
-		{
-			buffer += used;
-			l -= used;
+		buffer += used;
+		l -= used;
+
+		if (!IsComplete(r))
 			break;
-		}
 
 		if (this == provider->sub)
 		{
@@ -507,24 +509,17 @@ bool RedisSocket::Read(const char *buffer, size_t l)
 			}
 		}
 
-		buffer += used;
-		l -= used;
-
 		r.Clear();
 	}
 
-	if (l)
-	{
-		save.resize(l);
-		std::copy(buffer, buffer + l, save.begin());
-	}
-	else
-		std::vector<char>().swap(save);
+	if (!rbuf.empty())
+		rbuf.erase(rbuf.begin(), rbuf.begin() + (total - l));
+	else if (l)
+		rbuf.assign(buffer, buffer + l);
 
 	return true;
 }
 
-
 class ModuleRedis : public Module
 {
 	std::map<Anope::string, MyRedisService *> services;
@@ -161,7 +161,7 @@ class InspIRCd12Proto : public IRCDProto
 	{
 		UserMode *um = ModeManager::FindUserModeByName("CLOAK");
 
-		if (um && !u->HasMode(um->name))
+		if (um && !u->HasMode(um))
 			// Just set +x if we can
 			u->SetMode(NULL, um);
 		else
@@ -36,6 +36,11 @@ class SGLineManager : public XLineManager
 		IRCD->SendAkillDel(x);
 	}
 
+	bool IsHostIndexed() const anope_override
+	{
+		return true;
+	}
+
 	bool Check(User *u, const XLine *x) anope_override
 	{
 		if (x->regex)
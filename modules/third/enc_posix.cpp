@@ -10,6 +10,53 @@
 
 #include "module.h"
 
+/* crypt() uses a static buffer so only one thread may call it at a time */
+static Mutex crypt_lock;
+
+static Anope::string Crypt(const Anope::string &src, const Anope::string &salt)
+{
+	crypt_lock.Lock();
+	const char *hash = crypt(src.c_str(), salt.c_str());
+	Anope::string ret = hash ? hash : "";
+	crypt_lock.Unlock();
+	return ret;
+}
+
+/* Checks a password against an account's hash in a worker thread */
+class PosixCheck : public Task
+{
+	IdentifyRequest *req;
+	Anope::string password, pass, salt;
+	bool matched;
+
+ public:
+	PosixCheck(Module *o, IdentifyRequest *r, const Anope::string &p, const Anope::string &s) : Task(o), req(r), password(r->GetPassword()), pass(p), salt(s), matched(false)
+	{
+		req->Hold(owner);
+	}
+
+	void Run() anope_override
+	{
+		matched = pass.equals_cs("posix:" + Crypt(password, salt));
+	}
+
+	void OnComplete() anope_override
+	{
+		NickAlias *na = NickAlias::Find(req->GetAccount());
+		/* The password may have changed while it was being checked */
+		if (matched && na && na->nc->pass.equals_cs(pass))
+		{
+			/* if we are NOT the first module in the list,
+			 * we want to re-encrypt the pass with the new encryption
+			 */
+			if (ModuleManager::FindFirstOf(ENCRYPTION) != owner)
+				Anope::Encrypt(password, na->nc->pass);
+			req->Success(owner);
+		}
+		req->Release(owner);
+	}
+};
+
 class EPosix : public Module
 {
     std::string salt;
@@ -59,7 +106,7 @@ class EPosix : public Module
 			use_salt = false;
 
 		std::stringstream buf;
-		buf << "posix:" << crypt(src.c_str(), salt.c_str());
+		buf << "posix:" << Crypt(src, salt);
 
 		Log(LOG_DEBUG_2) << "(enc_posix) hashed password from [" << src << "] to [" << buf.str() << "]";
 		dest = buf.str();
@@ -82,19 +129,8 @@ class EPosix : public Module
 
 		if (!GetSaltFromPass(nc->pass))
 			return;
-		use_salt = true;
 
-		Anope::string buf;
-		this->OnEncrypt(req->GetPassword(), buf);
-		if (nc->pass.equals_cs(buf))
-		{
-			/* if we are NOT the first module in the list,
-			 * we want to re-encrypt the pass with the new encryption
-			 */
-			if (ModuleManager::FindFirstOf(ENCRYPTION) != this)
-				Anope::Encrypt(req->GetPassword(), nc->pass);
-			req->Success(this);
-		}
+		WorkerPool::Queue(new PosixCheck(this, req, nc->pass, salt));
 	}
 };
 
@@ -423,7 +423,8 @@ bool CreateChan(const ChanTrapInfo *ct)
 	OperServ->Join(c, &status);
 	if (!created)
 	{
-		for (Channel::ModeList::const_iterator it = c->GetModes().begin(); it != c->GetModes().end(); )
+		const Channel::ModeList modes = c->GetModes();
+		for (Channel::ModeList::const_iterator it = modes.begin(); it != modes.end(); )
 		{
 			const Anope::string mode = it->first, modearg = it->second;
 			++it;
@@ -13,29 +13,115 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
-StaticFileServer::StaticFileServer(const Anope::string &f_n, const Anope::string &u, const Anope::string &c_t) : HTTPPage(u, c_t), file_name(f_n)
+static bool ReadFile(const Anope::string &path, Anope::string &buf, struct stat &st)
 {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	buf.clear();
+
+	int i;
+	char buffer[BUFSIZE];
+	while ((i = read(fd, buffer, sizeof(buffer))) > 0)
+		buf.append(buffer, i);
+
+	close(fd);
+	return i == 0;
 }
 
-bool StaticFileServer::OnRequest(HTTPProvider *server, const Anope::string &page_name, HTTPClient *client, HTTPMessage &message, HTTPReply &reply)
+/* Builds a strong entity tag from the content of a file */
+static Anope::string MakeETag(const Anope::string &buf)
 {
-	int fd = open((template_base + "/" + this->file_name).c_str(), O_RDONLY);
-	if (fd < 0)
+	static const char key[16] = { 'w', 'e', 'b', 'c', 'p', 'a', 'n', 'e', 'l', '-', 's', 't', 'a', 't', 'i', 'c' };
+	uint64_t hash = Anope::SipHash24(buf.c_str(), buf.length(), key);
+
+	char etag[48];
+	snprintf(etag, sizeof(etag), "\"%lx-%08lx%08lx\"", static_cast<unsigned long>(buf.length()), static_cast<unsigned long>(hash >> 32), static_cast<unsigned long>(hash & 0xFFFFFFFF));
+	return etag;
+}
+
+static const Anope::string *FindHeader(const HTTPMessage &message, const Anope::string &name)
+{
+	for (std::map<Anope::string, Anope::string>::const_iterator it = message.headers.begin(), it_end = message.headers.end(); it != it_end; ++it)
+		if (it->first.equals_ci(name))
+			return &it->second;
+	return NULL;
+}
+
+StaticFileServer::StaticFileServer(const Anope::string &f_n, const Anope::string &u, const Anope::string &c_t) : HTTPPage(u, c_t), file_name(f_n), loaded(false)
+{
+}
+
+bool StaticFileServer::Load()
+{
+	const Anope::string path = template_base + "/" + this->file_name;
+	struct stat st;
+
+	this->loaded = ReadFile(path, this->data, st);
+	if (!this->loaded)
 	{
-		Log(LOG_NORMAL, "httpd") << "Error serving file " << page_name << " (" << (template_base + "/" + this->file_name) << "): " << strerror(errno);
+		Log(LOG_NORMAL, "httpd") << "Error reading file " << path << ": " << strerror(errno);
+		return false;
+	}
+
+	this->etag = MakeETag(this->data);
+
+	char timebuf[64];
+	strftime(timebuf, sizeof(timebuf), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&st.st_mtime));
+	this->last_modified = timebuf;
+
+	struct stat gzst;
+	if (ReadFile(path + ".gz", this->gzdata, gzst))
+		this->gzetag = MakeETag(this->gzdata);
+	else
+	{
+		this->gzdata.clear();
+		this->gzetag.clear();
+	}
 
+	return true;
+}
+
+bool StaticFileServer::OnRequest(HTTPProvider *server, const Anope::string &page_name, HTTPClient *client, HTTPMessage &message, HTTPReply &reply)
+{
+	if (!this->loaded && !this->Load())
+	{
 		client->SendError(HTTP_PAGE_NOT_FOUND, "Page not found");
 		return true;
 	}
 
+	const Anope::string *accept_encoding = FindHeader(message, "Accept-Encoding");
+	bool gzip = !this->gzdata.empty() && accept_encoding && accept_encoding->find_ci("gzip") != Anope::string::npos;
+	const Anope::string &tag = gzip ? this->gzetag : this->etag;
+
 	reply.content_type = this->GetContentType();
 	reply.headers["Cache-Control"] = "public";
+	reply.headers["ETag"] = tag;
+	reply.headers["Last-Modified"] = this->last_modified;
+	if (!this->gzdata.empty())
+		reply.headers["Vary"] = "Accept-Encoding";
 
-	int i;
-	char buffer[BUFSIZE];
-	while ((i = read(fd, buffer, sizeof(buffer))) > 0)
-		reply.Write(buffer, i);
+	const Anope::string *if_none_match = FindHeader(message, "If-None-Match"), *if_modified_since = FindHeader(message, "If-Modified-Since");
+	if (if_none_match ? (*if_none_match == "*" || if_none_match->find(tag) != Anope::string::npos) : (if_modified_since && *if_modified_since == this->last_modified))
+	{
+		reply.error = HTTP_NOT_MODIFIED;
+		return true;
+	}
+
+	if (gzip)
+	{
+		reply.headers["Content-Encoding"] = "gzip";
+		reply.Write(this->gzdata.c_str(), this->gzdata.length());
+	}
+	else
+		reply.Write(this->data.c_str(), this->data.length());
 
-	close(fd);
 	return true;
 }
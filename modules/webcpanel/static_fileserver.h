@@ -7,12 +7,25 @@
 
 #include "modules/httpd.h"
 
-/* A basic file server. Used for serving static content on disk. */
+/* A basic file server. Used for serving static content on disk. The file is held
+ * in memory, along with a gzipped copy if one exists next to it as file_name.gz.
+ */
 class StaticFileServer : public HTTPPage
 {
 	Anope::string file_name;
+
+	/* Whether the file has been read */
+	bool loaded;
+	Anope::string data, gzdata;
+	Anope::string etag, gzetag, last_modified;
+
  public:
 	StaticFileServer(const Anope::string &f_n, const Anope::string &u, const Anope::string &c_t);
 
+	/** Reads the file into memory
+	 * @return true if the file could be read
+	 */
+	bool Load();
+
 	bool OnRequest(HTTPProvider *, const Anope::string &, HTTPClient *, HTTPMessage &, HTTPReply &) anope_override;
 };
@@ -14,11 +14,184 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
-struct ForLoop
+/* How much output is built up before it is sent to the client */
+static const size_t FLUSH_SIZE = 16384;
+
+namespace
 {
-	static std::vector<ForLoop> Stack;
+	/* A single instruction of a compiled template */
+	struct Op
+	{
+		enum Type
+		{
+			TEXT,     /* Literal text */
+			VARIABLE, /* A replacement, escaped */
+			IF_EQ,    /* {IF EQ a b} */
+			IF_EXISTS,/* {IF EXISTS name} */
+			ELSE,
+			END_IF,
+			FOR,      /* {FOR a,b IN A,B} */
+			END_FOR,
+			INCLUDE   /* {INCLUDE file} */
+		} type;
+
+		/* The text, variable name, compared or tested replacement, or included file */
+		Anope::string name;
+		/* The second operand of IF EQ, or the loop and replacement variables of FOR */
+		Anope::string operand;
+		std::vector<Anope::string> vars, real_vars;
+
+		Op(Type t, const Anope::string &n = "") : type(t), name(n) { }
+	};
+
+	/* A template file parsed into a list of instructions */
+	struct Template
+	{
+		time_t mtime;
+		off_t size;
+		std::vector<Op> ops;
+
+		Template() : mtime(0), size(-1) { }
+
+		void Compile(const Anope::string &file_name, const Anope::string &buf)
+		{
+			this->ops.clear();
+
+			Anope::string text;
+			for (size_t j = 0; j < buf.length(); ++j)
+			{
+				if (buf[j] == '\\' && j + 1 < buf.length() && (buf[j + 1] == '{' || buf[j + 1] == '}'))
+				{
+					text += buf[++j];
+					continue;
+				}
+				else if (buf[j] != '{')
+				{
+					text += buf[j];
+					continue;
+				}
+
+				size_t f = buf.find('}', j);
+				if (f == Anope::string::npos)
+					break;
+				const Anope::string content = buf.substr(j + 1, f - j - 1);
+				j = f;
+
+				if (!text.empty())
+				{
+					this->ops.push_back(Op(Op::TEXT, text));
+					text.clear();
+				}
 
-	size_t start;       /* Index of start of this loop */
+				if (content.find("IF ") == 0)
+				{
+					std::vector<Anope::string> tokens;
+					spacesepstream(content).GetTokens(tokens);
+
+					if (tokens.size() == 4 && tokens[1] == "EQ")
+					{
+						Op op(Op::IF_EQ, tokens[2]);
+						op.operand = tokens[3];
+						this->ops.push_back(op);
+					}
+					else if (tokens.size() == 3 && tokens[1] == "EXISTS")
+						this->ops.push_back(Op(Op::IF_EXISTS, tokens[2]));
+					else
+						Log() << "Invalid IF in web template " << file_name;
+				}
+				else if (content == "ELSE")
+					this->ops.push_back(Op(Op::ELSE));
+				else if (content == "END IF")
+					this->ops.push_back(Op(Op::END_IF));
+				else if (content.find("FOR ") == 0)
+				{
+					std::vector<Anope::string> tokens;
+					spacesepstream(content).GetTokens(tokens);
+
+					if (tokens.size() != 4 || tokens[2] != "IN")
+						Log() << "Invalid FOR in web template " << file_name;
+					else
+					{
+						Op op(Op::FOR);
+						commasepstream(tokens[1]).GetTokens(op.vars);
+						commasepstream(tokens[3]).GetTokens(op.real_vars);
+
+						if (op.vars.size() != op.real_vars.size())
+							Log() << "Invalid FOR in web template " << file_name << " variable mismatch";
+						else
+							this->ops.push_back(op);
+					}
+				}
+				else if (content == "END FOR")
+					this->ops.push_back(Op(Op::END_FOR));
+				else if (content.find("INCLUDE ") == 0)
+				{
+					std::vector<Anope::string> tokens;
+					spacesepstream(content).GetTokens(tokens);
+
+					if (tokens.size() != 2)
+						Log() << "Invalid INCLUDE in web template " << file_name;
+					else
+						this->ops.push_back(Op(Op::INCLUDE, tokens[1]));
+				}
+				else
+					this->ops.push_back(Op(Op::VARIABLE, content));
+			}
+
+			if (!text.empty())
+				this->ops.push_back(Op(Op::TEXT, text));
+		}
+	};
+
+	/* Compiled templates, by path */
+	std::map<Anope::string, Template> templates;
+
+	/** Finds the compiled form of a template, compiling it if it has changed since it was last used
+	 * @return The template, or NULL if it can not be read, with errno set
+	 */
+	const Template *LoadTemplate(const Anope::string &file_name)
+	{
+		const Anope::string path = template_base + "/" + file_name;
+
+		struct stat st;
+		if (stat(path.c_str(), &st) < 0)
+		{
+			templates.erase(path);
+			return NULL;
+		}
+
+		Template &t = templates[path];
+		if (t.mtime == st.st_mtime && t.size == st.st_size)
+			return &t;
+
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			templates.erase(path);
+			return NULL;
+		}
+
+		Anope::string buf;
+
+		int i;
+		char buffer[BUFSIZE];
+		while ((i = read(fd, buffer, sizeof(buffer))) > 0)
+			buf.append(buffer, i);
+
+		close(fd);
+
+		t.Compile(file_name, buf);
+		t.mtime = st.st_mtime;
+		t.size = st.st_size;
+
+		Log(LOG_DEBUG, "httpd") << "Compiled web template " << path << " into " << t.ops.size() << " instructions";
+		return &t;
+	}
+}
+
+struct ForLoop
+{
+	size_t start;       /* Index of the FOR instruction of this loop */
 	std::vector<Anope::string> vars; /* User defined variables */
 	typedef std::pair<TemplateFileServer::Replacements::iterator, TemplateFileServer::Replacements::iterator> range;
 	std::vector<range> ranges; /* iterator ranges for each variable */
@@ -53,16 +226,21 @@ struct ForLoop
 		return true;
 	}
 };
-std::vector<ForLoop> ForLoop::Stack;
 
-std::stack<bool> IfStack;
+/* The state of a page being rendered, shared with the templates it includes */
+struct RenderState
+{
+	std::vector<ForLoop> loops;
+	std::stack<bool> ifs;
+	Anope::string finished;
+};
 
-static Anope::string FindReplacement(const TemplateFileServer::Replacements &r, const Anope::string &key)
+static Anope::string FindReplacement(const RenderState &state, const TemplateFileServer::Replacements &r, const Anope::string &key)
 {
 	/* Search first through for loop stack then global replacements */
-	for (unsigned i = ForLoop::Stack.size(); i > 0; --i)
+	for (unsigned i = state.loops.size(); i > 0; --i)
 	{
-		ForLoop &fl = ForLoop::Stack[i - 1];
+		const ForLoop &fl = state.loops[i - 1];
 
 		for (unsigned j = 0; j < fl.vars.size(); ++j)
 		{
@@ -86,182 +264,116 @@ static Anope::string FindReplacement(const TemplateFileServer::Replacements &r,
 	return "";
 }
 
-TemplateFileServer::TemplateFileServer(const Anope::string &f_n) : file_name(f_n)
-{
-}
-
-void TemplateFileServer::Serve(HTTPProvider *server, const Anope::string &page_name, HTTPClient *client, HTTPMessage &message, HTTPReply &reply, Replacements &r)
+static bool Render(const Anope::string &file_name, HTTPClient *client, HTTPReply &reply, TemplateFileServer::Replacements &r, RenderState &state)
 {
-	int fd = open((template_base + "/" + this->file_name).c_str(), O_RDONLY);
-	if (fd < 0)
+	const Template *t = LoadTemplate(file_name);
+	if (t == NULL)
 	{
-		Log(LOG_NORMAL, "httpd") << "Error serving file " << page_name << " (" << (template_base + "/" + this->file_name) << "): " << strerror(errno);
-
-		client->SendError(HTTP_PAGE_NOT_FOUND, "Page not found");
-		return;
+		Log(LOG_NORMAL, "httpd") << "Error reading web template " << (template_base + "/" + file_name) << ": " << strerror(errno);
+		return false;
 	}
 
-	Anope::string buf;
-
-	int i;
-	char buffer[BUFSIZE];
-	while ((i = read(fd, buffer, sizeof(buffer) - 1)) > 0)
+	const std::vector<Op> &ops = t->ops;
+	for (size_t i = 0; i < ops.size(); ++i)
 	{
-		buffer[i] = 0;
-		buf += buffer;
-	}
+		const Op &op = ops[i];
 
-	close(fd);
+		// If the if stack is empty or we are in a true statement
+		bool ifok = state.ifs.empty() || state.ifs.top();
+		bool forok = state.loops.empty() || !state.loops.back().finished(r);
 
-	Anope::string finished;
-
-	bool escaped = false;
-	for (unsigned j = 0; j < buf.length(); ++j)
-	{
-		if (buf[j] == '\\' && j + 1 < buf.length() && (buf[j + 1] == '{' || buf[j + 1] == '}'))
-			escaped = true;
-		else if (buf[j] == '{' && !escaped)
+		switch (op.type)
 		{
-			size_t f = buf.substr(j).find('}');
-			if (f == Anope::string::npos)
+			case Op::TEXT:
+				if (ifok && forok)
+					state.finished += op.name;
 				break;
-			const Anope::string &content = buf.substr(j + 1, f - 1);
-
-			if (content.find("IF ") == 0)
+			case Op::VARIABLE:
+				// htmlescape all text replaced onto the page
+				if (ifok && forok)
+					state.finished += HTTPUtils::Escape(FindReplacement(state, r, op.name));
+				break;
+			case Op::IF_EQ:
 			{
-				std::vector<Anope::string> tokens;
-				spacesepstream(content).GetTokens(tokens);
+				Anope::string first = FindReplacement(state, r, op.name), second = FindReplacement(state, r, op.operand);
+				if (first.empty())
+					first = op.name;
+				if (second.empty())
+					second = op.operand;
 
-				if (tokens.size() == 4 && tokens[1] == "EQ")
-				{
-					Anope::string first = FindReplacement(r, tokens[2]), second = FindReplacement(r, tokens[3]);
-					if (first.empty())
-						first = tokens[2];
-					if (second.empty())
-						second = tokens[3];
-
-					bool stackok = IfStack.empty() || IfStack.top();
-					IfStack.push(stackok && first == second);
-				}
-				else if (tokens.size() == 3 && tokens[1] == "EXISTS")
-				{
-					bool stackok = IfStack.empty() || IfStack.top();
-					IfStack.push(stackok && r.count(tokens[2]) > 0);
-				}
-				else
-					Log() << "Invalid IF in web template " << this->file_name;
+				state.ifs.push(ifok && first == second);
+				break;
 			}
-			else if (content == "ELSE")
-			{
-				if (IfStack.empty())
-					Log() << "Invalid ELSE with no stack in web template" << this->file_name;
+			case Op::IF_EXISTS:
+				state.ifs.push(ifok && r.count(op.name) > 0);
+				break;
+			case Op::ELSE:
+				if (state.ifs.empty())
+					Log() << "Invalid ELSE with no stack in web template " << file_name;
 				else
 				{
-					bool old = IfStack.top();
-					IfStack.pop(); // Pop off previous if()
-					bool stackok = IfStack.empty() || IfStack.top();
-					IfStack.push(stackok && !old); // Push back the opposite of what was popped
+					bool old = state.ifs.top();
+					state.ifs.pop(); // Pop off previous if()
+					bool stackok = state.ifs.empty() || state.ifs.top();
+					state.ifs.push(stackok && !old); // Push back the opposite of what was popped
 				}
-			}
-			else if (content == "END IF")
-			{
-				if (IfStack.empty())
+				break;
+			case Op::END_IF:
+				if (state.ifs.empty())
 					Log() << "END IF with empty stack?";
 				else
-					IfStack.pop();
-			}
-			else if (content.find("FOR ") == 0)
-			{
-				std::vector<Anope::string> tokens;
-				spacesepstream(content).GetTokens(tokens);
-
-				if (tokens.size() != 4 || tokens[2] != "IN")
-					Log() << "Invalid FOR in web template " << this->file_name;
-				else
-				{
-					std::vector<Anope::string> temp_variables, real_variables;
-					commasepstream(tokens[1]).GetTokens(temp_variables);
-					commasepstream(tokens[3]).GetTokens(real_variables);
-
-					if (temp_variables.size() != real_variables.size())
-						Log() << "Invalid FOR in web template " << this->file_name << " variable mismatch";
-					else
-						ForLoop::Stack.push_back(ForLoop(j + f, r, temp_variables, real_variables));
-				}
-			}
-			else if (content == "END FOR")
-			{
-				if (ForLoop::Stack.empty())
+					state.ifs.pop();
+				break;
+			case Op::FOR:
+				state.loops.push_back(ForLoop(i, r, op.vars, op.real_vars));
+				break;
+			case Op::END_FOR:
+				if (state.loops.empty())
 					Log() << "END FOR with empty stack?";
 				else
 				{
-					ForLoop &fl = ForLoop::Stack.back();
+					ForLoop &fl = state.loops.back();
+					if (!fl.finished(r))
+						fl.increment(r);
 					if (fl.finished(r))
-						ForLoop::Stack.pop_back();
+						state.loops.pop_back();
 					else
-					{
-						fl.increment(r);
-						if (fl.finished(r))
-							ForLoop::Stack.pop_back();
-						else
-						{
-							j = fl.start; // Move pointer back to start of the loop
-							continue; // To prevent skipping over this block which doesn't exist anymore
-						}
-					}
-				}
-			}
-			else if (content.find("INCLUDE ") == 0)
-			{
-				std::vector<Anope::string> tokens;
-				spacesepstream(content).GetTokens(tokens);
-
-				if (tokens.size() != 2)
-					Log() << "Invalid INCLUDE in web template " << this->file_name;
-				else
-				{
-					if (!finished.empty())
-					{
-						reply.Write(finished); // Write out what we have currently so we insert this files contents here
-						finished.clear();
-					}
-
-					TemplateFileServer tfs(tokens[1]);
-					tfs.Serve(server, page_name, client, message, reply, r);
+						i = fl.start; // Move back to the start of the loop
 				}
-			}
-			else
-			{
-				// If the if stack is empty or we are in a true statement
-				bool ifok = IfStack.empty() || IfStack.top();
-				bool forok = ForLoop::Stack.empty() || !ForLoop::Stack.back().finished(r);
-
-				if (ifok && forok)
-				{
-					Anope::string replacement = FindReplacement(r, content.substr(0, f - 1));
+				break;
+			case Op::INCLUDE:
+				// Included templates share the state so their output is only wanted in a true statement
+				if (ifok && forok && !Render(op.name, client, reply, r, state))
+					return false;
+				break;
+		}
 
-					// htmlescape all text replaced onto the page
-					replacement = HTTPUtils::Escape(replacement);
+		// Stream large pages out as they are built instead of holding all of them in memory
+		if (state.finished.length() >= FLUSH_SIZE)
+		{
+			reply.Write(state.finished);
+			state.finished.clear();
+			client->Flush(&reply);
+		}
+	}
 
-					finished += replacement;
-				}
-			}
+	return true;
+}
 
-			j += f; // Skip over this whole block
-		}
-		else
-		{
-			escaped = false;
+TemplateFileServer::TemplateFileServer(const Anope::string &f_n) : file_name(f_n)
+{
+}
 
-			// If the if stack is empty or we are in a true statement
-			bool ifok = IfStack.empty() || IfStack.top();
-			bool forok = ForLoop::Stack.empty() || !ForLoop::Stack.back().finished(r);
+void TemplateFileServer::Serve(HTTPProvider *server, const Anope::string &page_name, HTTPClient *client, HTTPMessage &message, HTTPReply &reply, Replacements &r)
+{
+	RenderState state;
 
-			if (ifok && forok)
-				finished += buf[j];
-		}
+	if (!Render(this->file_name, client, reply, r, state))
+	{
+		client->SendError(HTTP_PAGE_NOT_FOUND, "Page not found");
+		return;
 	}
 
-	if (!finished.empty())
-		reply.Write(finished);
+	if (!state.finished.empty())
+		reply.Write(state.finished);
 }
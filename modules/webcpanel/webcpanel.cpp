@@ -68,6 +68,11 @@ class ModuleWebCPanel : public Module
 		if (!provider)
 			throw ModuleException("Unable to find HTTPD provider. Is m_httpd loaded?");
 
+		this->style_css.Load();
+		this->logo_png.Load();
+		this->cubes_png.Load();
+		this->favicon_ico.Load();
+
 		provider->RegisterPage(&this->style_css);
 		provider->RegisterPage(&this->logo_png);
 		provider->RegisterPage(&this->cubes_png);
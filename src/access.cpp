@@ -59,7 +59,9 @@ static struct
 	{"VOICEME", _("Allowed to (de)voice him/herself")}
 };
 
-Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : name(n), desc(d), rank(r)
+static Anope::map<unsigned> PrivilegeIDs;
+
+Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : name(n), desc(d), rank(r), id(PrivilegeManager::GetID(n))
 {
 	if (this->desc.empty())
 		for (unsigned j = 0; j < sizeof(descriptions) / sizeof(*descriptions); ++j)
@@ -73,6 +75,17 @@ bool Privilege::operator==(const Privilege &other) const
 }
 
 std::vector<Privilege> PrivilegeManager::Privileges;
+std::vector<int> PrivilegeManager::Positions;
+unsigned PrivilegeManager::Revision = 1;
+
+void PrivilegeManager::BuildPositions()
+{
+	Positions.assign(PrivilegeIDs.size(), -1);
+	/* If a privilege is added more than once the last one wins, like FindPrivilege used to */
+	for (unsigned i = 0; i < Privileges.size(); ++i)
+		Positions[Privileges[i].id] = i;
+	Invalidate();
+}
 
 void PrivilegeManager::AddPrivilege(Privilege p)
 {
@@ -86,6 +99,7 @@ void PrivilegeManager::AddPrivilege(Privilege p)
 	}
 
 	Privileges.insert(Privileges.begin() + i, p);
+	BuildPositions();
 }
 
 void PrivilegeManager::RemovePrivilege(Privilege &p)
@@ -93,6 +107,7 @@ void PrivilegeManager::RemovePrivilege(Privilege &p)
 	std::vector<Privilege>::iterator it = std::find(Privileges.begin(), Privileges.end(), p);
 	if (it != Privileges.end())
 		Privileges.erase(it);
+	BuildPositions();
 
 	for (registered_channel_map::const_iterator cit = RegisteredChannelList->begin(), cit_end = RegisteredChannelList->end(); cit != cit_end; ++cit)
 	{
@@ -103,10 +118,17 @@ void PrivilegeManager::RemovePrivilege(Privilege &p)
 
 Privilege *PrivilegeManager::FindPrivilege(const Anope::string &name)
 {
-	for (unsigned i = Privileges.size(); i > 0; --i)
-		if (Privileges[i - 1].name.equals_ci(name))
-			return &Privileges[i - 1];
-	return NULL;
+	Anope::map<unsigned>::const_iterator it = PrivilegeIDs.find(name);
+	if (it == PrivilegeIDs.end())
+		return NULL;
+	return FindPrivilege(it->second);
+}
+
+Privilege *PrivilegeManager::FindPrivilege(unsigned id)
+{
+	if (id >= Positions.size() || Positions[id] < 0)
+		return NULL;
+	return &Privileges[Positions[id]];
 }
 
 std::vector<Privilege> &PrivilegeManager::GetPrivileges()
@@ -117,6 +139,28 @@ std::vector<Privilege> &PrivilegeManager::GetPrivileges()
 void PrivilegeManager::ClearPrivileges()
 {
 	Privileges.clear();
+	BuildPositions();
+}
+
+unsigned PrivilegeManager::GetID(const Anope::string &name)
+{
+	Anope::map<unsigned>::iterator it = PrivilegeIDs.find(name);
+	if (it != PrivilegeIDs.end())
+		return it->second;
+
+	unsigned id = PrivilegeIDs.size();
+	PrivilegeIDs[name] = id;
+	return id;
+}
+
+unsigned PrivilegeManager::GetRevision()
+{
+	return Revision;
+}
+
+void PrivilegeManager::Invalidate()
+{
+	++Revision;
 }
 
 AccessProvider::AccessProvider(Module *o, const Anope::string &n) : Service(o, "AccessProvider", n)
@@ -138,7 +182,7 @@ const std::list<AccessProvider *>& AccessProvider::GetProviders()
 	return Providers;
 }
 
-ChanAccess::ChanAccess(AccessProvider *p) : Serializable("ChanAccess"), provider(p)
+ChanAccess::ChanAccess(AccessProvider *p) : Serializable("ChanAccess"), privileges_revision(0), privileges_known(false), provider(p)
 {
 }
 
@@ -146,6 +190,8 @@ ChanAccess::~ChanAccess()
 {
 	if (this->ci)
 	{
+		ChannelInfo::ClearAccessCache();
+
 		std::vector<ChanAccess *>::iterator it = std::find(this->ci->access->begin(), this->ci->access->end(), this);
 		if (it != this->ci->access->end())
 			this->ci->access->erase(it);
@@ -175,6 +221,7 @@ void ChanAccess::SetMask(const Anope::string &m, ChannelInfo *c)
 	ci = c;
 	mask.clear();
 	nc = NULL;
+	ChannelInfo::ClearAccessCache();
 
 	const NickAlias *na = NickAlias::Find(m);
 	if (na != NULL)
@@ -244,6 +291,7 @@ Serializable* ChanAccess::Unserialize(Serializable *obj, Serialize::Data &data)
 	Anope::string adata;
 	data["data"] >> adata;
 	access->AccessUnserialize(adata);
+	access->privileges_revision = 0;
 
 	if (!obj)
 		ci->AddAccess(access);
@@ -284,13 +332,34 @@ bool ChanAccess::Matches(const User *u, const NickCore *acc, ChannelInfo* &next)
 	return false;
 }
 
+bool ChanAccess::GetPrivileges(PrivilegeSet &) const
+{
+	return false;
+}
+
+bool ChanAccess::HasPriv(unsigned privid) const
+{
+	if (this->privileges_revision != PrivilegeManager::GetRevision())
+	{
+		this->privileges.Clear();
+		this->privileges_known = this->GetPrivileges(this->privileges);
+		this->privileges_revision = PrivilegeManager::GetRevision();
+	}
+
+	if (this->privileges_known)
+		return this->privileges.Has(privid);
+
+	const Privilege *p = PrivilegeManager::FindPrivilege(privid);
+	return p != NULL && this->HasPriv(p->name);
+}
+
 bool ChanAccess::operator>(const ChanAccess &other) const
 {
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPriv(privs[i - 1].id),
+			other_p = other.HasPriv(privs[i - 1].id);
 
 		if (!this_p && !other_p)
 			continue;
@@ -306,8 +375,8 @@ bool ChanAccess::operator<(const ChanAccess &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPriv(privs[i - 1].id),
+			other_p = other.HasPriv(privs[i - 1].id);
 
 		if (!this_p && !other_p)
 			continue;
@@ -335,7 +404,7 @@ AccessGroup::AccessGroup()
 	this->super_admin = this->founder = false;
 }
 
-static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name)
+static bool HasPriv(const ChanAccess::Path &path, const Privilege *priv)
 {
 	if (path.empty())
 		return false;
@@ -345,9 +414,9 @@ static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name)
 		ChanAccess *access = path[i];
 
 		EventReturn MOD_RESULT;
-		FOREACH_RESULT(OnCheckPriv, MOD_RESULT, (access, name));
+		FOREACH_RESULT(OnCheckPriv, MOD_RESULT, (access, priv->name));
 
-		if (MOD_RESULT != EVENT_ALLOW && !access->HasPriv(name))
+		if (MOD_RESULT != EVENT_ALLOW && !access->HasPriv(priv->id))
 			return false;
 	}
 
@@ -358,9 +427,27 @@ bool AccessGroup::HasPriv(const Anope::string &name) const
 {
 	if (this->super_admin)
 		return true;
-	else if (!ci || ci->GetLevel(name) == ACCESS_INVALID)
+
+	const Privilege *priv = PrivilegeManager::FindPrivilege(name);
+	if (priv == NULL)
+	{
+		Log(LOG_DEBUG) << "Unknown privilege " + name;
+		return false;
+	}
+
+	return this->HasPriv(priv->id);
+}
+
+bool AccessGroup::HasPriv(unsigned id) const
+{
+	if (this->super_admin)
+		return true;
+	else if (!ci || ci->GetLevel(id) == ACCESS_INVALID)
 		return false;
 
+	const Privilege *priv = PrivilegeManager::FindPrivilege(id);
+	const Anope::string &name = priv->name;
+
 	/* Privileges prefixed with auto are understood to be given
 	 * automatically. Sometimes founders want to not automatically
 	 * obtain privileges, so we will let them */
@@ -379,7 +466,7 @@ bool AccessGroup::HasPriv(const Anope::string &name) const
 	{
 		const ChanAccess::Path &path = paths[i - 1];
 
-		if (::HasPriv(path, name))
+		if (::HasPriv(path, priv))
 			return true;
 	}
 
@@ -426,8 +513,8 @@ bool AccessGroup::operator>(const AccessGroup &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPriv(privs[i - 1].id),
+			other_p = other.HasPriv(privs[i - 1].id);
 
 		if (!this_p && !other_p)
 			continue;
@@ -452,8 +539,8 @@ bool AccessGroup::operator<(const AccessGroup &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPriv(privs[i - 1].id),
+			other_p = other.HasPriv(privs[i - 1].id);
 
 		if (!this_p && !other_p)
 			continue;
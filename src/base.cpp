@@ -17,32 +17,47 @@ Base::Base() : references(NULL)
 {
 }
 
+Base::Base(const Base &) : references(NULL)
+{
+}
+
+Base &Base::operator=(const Base &)
+{
+	return *this;
+}
+
 Base::~Base()
 {
-	if (this->references != NULL)
+	for (ReferenceBase *r = this->references, *next; r; r = next)
 	{
-		for (std::set<ReferenceBase *>::iterator it = this->references->begin(), it_end = this->references->end(); it != it_end; ++it)
-			(*it)->Invalidate();
-		delete this->references;
+		next = r->next_reference;
+		r->prev_reference = r->next_reference = NULL;
+		r->Invalidate();
 	}
 }
 
 void Base::AddReference(ReferenceBase *r)
 {
-	if (this->references == NULL)
-		this->references = new std::set<ReferenceBase *>();
-	this->references->insert(r);
+	if (r->prev_reference || this->references == r)
+		return;
+
+	r->prev_reference = NULL;
+	r->next_reference = this->references;
+	if (this->references)
+		this->references->prev_reference = r;
+	this->references = r;
 }
 
 void Base::DelReference(ReferenceBase *r)
 {
-	if (this->references != NULL)
-	{
-		this->references->erase(r);
-		if (this->references->empty())
-		{
-			delete this->references;
-			this->references = NULL;
-		}
-	}
+	if (!r->prev_reference && this->references != r)
+		return;
+
+	if (r->prev_reference)
+		r->prev_reference->next_reference = r->next_reference;
+	else
+		this->references = r->next_reference;
+	if (r->next_reference)
+		r->next_reference->prev_reference = r->prev_reference;
+	r->prev_reference = r->next_reference = NULL;
 }
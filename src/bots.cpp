@@ -138,11 +138,13 @@ void BotInfo::OnKill()
 void BotInfo::SetNewNick(const Anope::string &newnick)
 {
 	UserListByNick.erase(this->nick);
+	UserIndexByNick.erase(this->nick);
 	BotListByNick->erase(this->nick);
 
 	this->nick = newnick;
 
 	UserListByNick[this->nick] = this;
+	UserIndexByNick[this->nick] = this;
 	(*BotListByNick)[this->nick] = this;
 }
 
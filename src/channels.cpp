@@ -28,6 +28,12 @@
 channel_map ChannelList;
 std::vector<Channel *> Channel::deleting;
 
+/* Modes without parameters are kept in flag_modes instead of the mode map */
+static inline bool IsFlagMode(const ChannelMode *cm)
+{
+	return cm->type == MODE_REGULAR && cm->mchar;
+}
+
 Channel::Channel(const Anope::string &nname, time_t ts)
 {
 	if (nname.empty())
@@ -69,6 +75,7 @@ Channel::~Channel()
 
 void Channel::Reset()
 {
+	this->flag_modes.reset();
 	this->modes.clear();
 
 	for (ChanUserList::const_iterator it = this->users.begin(), it_end = this->users.end(); it != it_end; ++it)
@@ -201,11 +208,30 @@ bool Channel::HasUserStatus(User *u, const Anope::string &mname)
 
 size_t Channel::HasMode(const Anope::string &mname, const Anope::string &param)
 {
+	ChannelMode *cm = ModeManager::FindChannelModeByName(mname);
+	if (cm)
+		return this->HasMode(cm, param);
+
 	if (param.empty())
 		return modes.count(mname);
-	std::vector<Anope::string> v = this->GetModeList(mname);
-	for (unsigned int i = 0; i < v.size(); ++i)
-		if (v[i].equals_ci(param))
+	for (ModeList::const_iterator it = modes.lower_bound(mname), it_end = modes.upper_bound(mname); it != it_end; ++it)
+		if (it->second.equals_ci(param))
+			return 1;
+	return 0;
+}
+
+size_t Channel::HasMode(ChannelMode *cm, const Anope::string &param)
+{
+	if (!cm)
+		return 0;
+
+	if (IsFlagMode(cm))
+		return param.empty() && this->flag_modes.test(static_cast<unsigned char>(cm->mchar));
+
+	if (param.empty())
+		return modes.count(cm->name);
+	for (ModeList::const_iterator it = modes.lower_bound(cm->name), it_end = modes.upper_bound(cm->name); it != it_end; ++it)
+		if (it->second.equals_ci(param))
 			return 1;
 	return 0;
 }
@@ -214,6 +240,16 @@ Anope::string Channel::GetModes(bool complete, bool plus)
 {
 	Anope::string res, params;
 
+	for (unsigned i = 0; i < this->flag_modes.size(); ++i)
+	{
+		if (!this->flag_modes.test(i))
+			continue;
+
+		ChannelMode *cm = ModeManager::FindChannelModeByChar(i);
+		if (cm && IsFlagMode(cm))
+			res += cm->mchar;
+	}
+
 	for (std::multimap<Anope::string, Anope::string>::const_iterator it = this->modes.begin(), it_end = this->modes.end(); it != it_end; ++it)
 	{
 		ChannelMode *cm = ModeManager::FindChannelModeByName(it->first);
@@ -236,9 +272,21 @@ Anope::string Channel::GetModes(bool complete, bool plus)
 	return res + params;
 }
 
-const Channel::ModeList &Channel::GetModes() const
+Channel::ModeList Channel::GetModes() const
 {
-	return this->modes;
+	ModeList m = this->modes;
+
+	for (unsigned i = 0; i < this->flag_modes.size(); ++i)
+	{
+		if (!this->flag_modes.test(i))
+			continue;
+
+		ChannelMode *cm = ModeManager::FindChannelModeByChar(i);
+		if (cm && IsFlagMode(cm))
+			m.insert(std::make_pair(cm->name, ""));
+	}
+
+	return m;
 }
 
 template<typename F, typename S>
@@ -253,6 +301,13 @@ struct second
 std::vector<Anope::string> Channel::GetModeList(const Anope::string &mname)
 {
 	std::vector<Anope::string> r;
+	ChannelMode *cm = ModeManager::FindChannelModeByName(mname);
+	if (cm && IsFlagMode(cm))
+	{
+		if (this->HasMode(cm))
+			r.push_back("");
+		return r;
+	}
 	std::transform(modes.lower_bound(mname), modes.upper_bound(mname), std::back_inserter(r), second<Anope::string, Anope::string>());
 	return r;
 }
@@ -299,12 +354,17 @@ void Channel::SetModeInternal(MessageSource &setter, ChannelMode *ocm, const Ano
 		return;
 	}
 
-	if (cm->type != MODE_LIST)
-		this->modes.erase(cm->name);
-	else if (this->HasMode(cm->name, param))
-		return;
+	if (IsFlagMode(cm))
+		this->flag_modes.set(static_cast<unsigned char>(cm->mchar));
+	else
+	{
+		if (cm->type != MODE_LIST)
+			this->modes.erase(cm->name);
+		else if (this->HasMode(cm, param))
+			return;
 
-	this->modes.insert(std::make_pair(cm->name, param));
+		this->modes.insert(std::make_pair(cm->name, param));
+	}
 
 	if (param.empty() && cm->type != MODE_REGULAR)
 	{
@@ -379,6 +439,8 @@ void Channel::RemoveModeInternal(MessageSource &setter, ChannelMode *ocm, const
 				break;
 			}
 	}
+	else if (IsFlagMode(cm))
+		this->flag_modes.reset(static_cast<unsigned char>(cm->mchar));
 	else
 		this->modes.erase(cm->name);
 
@@ -412,7 +474,7 @@ void Channel::SetMode(BotInfo *bi, ChannelMode *cm, const Anope::string &param,
 	if (!cm)
 		return;
 	/* Don't set modes already set */
-	if (cm->type == MODE_REGULAR && HasMode(cm->name))
+	if (cm->type == MODE_REGULAR && HasMode(cm))
 		return;
 	else if (cm->type == MODE_PARAM)
 	{
@@ -437,7 +499,7 @@ void Channel::SetMode(BotInfo *bi, ChannelMode *cm, const Anope::string &param,
 		if (!cml->IsValid(wparam))
 			return;
 
-		if (this->HasMode(cm->name, wparam))
+		if (this->HasMode(cm, wparam))
 			return;
 	}
 
@@ -470,7 +532,7 @@ void Channel::RemoveMode(BotInfo *bi, ChannelMode *cm, const Anope::string &wpar
 		return;
 
 	/* Don't unset modes that arent set */
-	if ((cm->type == MODE_REGULAR || cm->type == MODE_PARAM) && !HasMode(cm->name))
+	if ((cm->type == MODE_REGULAR || cm->type == MODE_PARAM) && !HasMode(cm))
 		return;
 
 	/* Unwrap to be sure we have the internal representation */
@@ -486,7 +548,7 @@ void Channel::RemoveMode(BotInfo *bi, ChannelMode *cm, const Anope::string &wpar
 	}
 	else if (cm->type == MODE_LIST)
 	{
-		if (!this->HasMode(cm->name, param))
+		if (!this->HasMode(cm, param))
 			return;
 	}
 
@@ -535,7 +597,8 @@ bool Channel::GetParam(const Anope::string &mname, Anope::string &target) const
 		return true;
 	}
 
-	return false;
+	ChannelMode *cm = ModeManager::FindChannelModeByName(mname);
+	return cm && IsFlagMode(cm) && this->flag_modes.test(static_cast<unsigned char>(cm->mchar));
 }
 
 void Channel::SetModes(BotInfo *bi, bool enforce_mlock, const char *cmodes, ...)
@@ -663,7 +726,7 @@ void Channel::SetModesInternal(MessageSource &source, const Anope::string &mode,
 		if (cm->type == MODE_REGULAR)
 		{
 			/* something changed if we are adding a mode we don't have, or removing one we have */
-			changed |= !!add != this->HasMode(cm->name);
+			changed |= !!add != this->HasMode(cm);
 			if (add)
 				this->SetModeInternal(source, cm, "", false);
 			else
@@ -689,7 +752,7 @@ void Channel::SetModesInternal(MessageSource &source, const Anope::string &mode,
 			else
 				paramstring += " " + token;
 
-			changed |= !!add != this->HasMode(cm->name, token);
+			changed |= !!add != this->HasMode(cm, token);
 			/* CheckModes below doesn't check secureops (+ the module event) */
 			if (add)
 				this->SetModeInternal(source, cm, token, enforce_mlock);
@@ -11,15 +11,18 @@
 
 #include "services.h"
 #include "config.h"
+#include "language.h"
 #include "bots.h"
 #include "access.h"
 #include "opertype.h"
 #include "channels.h"
 #include "hashcomp.h"
+#include "regexpr.h"
 
 using Configuration::File;
 using Configuration::Conf;
 using Configuration::Internal::Block;
+using Configuration::SettingsBase;
 
 File ServicesConf("services.conf", false); // Services configuration file name
 Conf *Config = NULL;
@@ -133,6 +136,9 @@ Conf::Conf() : Block("")
 		this->LoadConf(f);
 	}
 
+	/* Parse typed settings first so an invalid value rejects the config before modules apply it */
+	SettingsBase::PrepareAll(this);
+
 	FOREACH_MOD(OnReload, (this));
 
 	/* Check for modified values that aren't allowed to be modified */
@@ -200,7 +206,6 @@ Conf::Conf() : Block("")
 		this->DefPrivmsg = std::find(defaults.begin(), defaults.end(), "msg") != defaults.end();
 	}
 	this->DefLanguage = options->Get<const Anope::string>("defaultlanguage");
-	this->TimeoutCheck = options->Get<time_t>("timeoutcheck");
 	this->NickChars = networkinfo->Get<Anope::string>("nick_chars");
 
 	for (int i = 0; i < this->CountBlock("uplink"); ++i)
@@ -546,6 +551,8 @@ Conf::Conf() : Block("")
 	/* Check the user keys */
 	if (!options->Get<unsigned>("seed"))
 		Log() << "Configuration option options:seed should be set. It's for YOUR safety! Remember that!";
+
+	SettingsBase::CommitAll();
 }
 
 Conf::~Conf()
@@ -558,6 +565,13 @@ Conf::~Conf()
 
 void Conf::Post(Conf *old)
 {
+	/* Expressions compiled with the old engine are of no use */
+	if (old->GetBlock("options")->Get<const Anope::string>("regexengine") != this->GetBlock("options")->Get<const Anope::string>("regexengine"))
+		Anope::ClearRegexCache();
+
+	/* Reload translations, as the languages or their files may have changed */
+	Language::InitLanguages();
+
 	/* Apply module changes */
 	for (unsigned i = 0; i < old->ModulesAutoLoad.size(); ++i)
 		if (std::find(this->ModulesAutoLoad.begin(), this->ModulesAutoLoad.end(), old->ModulesAutoLoad[i]) == this->ModulesAutoLoad.end())
@@ -632,6 +646,50 @@ Block *Conf::GetModule(const Anope::string &mname)
 	return GetModule(mname);
 }
 
+/* Every Settings, this is a function so it exists before any static Settings are constructed */
+static std::vector<SettingsBase *> &AllSettings()
+{
+	static std::vector<SettingsBase *> settings;
+	return settings;
+}
+
+SettingsBase::SettingsBase(Module *m) : block(m->name), module(true)
+{
+	AllSettings().push_back(this);
+}
+
+SettingsBase::SettingsBase(const Anope::string &b, bool m) : block(b), module(m)
+{
+	AllSettings().push_back(this);
+}
+
+SettingsBase::~SettingsBase()
+{
+	std::vector<SettingsBase *> &settings = AllSettings();
+	std::vector<SettingsBase *>::iterator it = std::find(settings.begin(), settings.end(), this);
+	if (it != settings.end())
+		settings.erase(it);
+}
+
+Configuration::Block *SettingsBase::GetBlock(Conf *conf) const
+{
+	return module ? conf->GetModule(block) : conf->GetBlock(block);
+}
+
+void SettingsBase::PrepareAll(Conf *conf)
+{
+	std::vector<SettingsBase *> &settings = AllSettings();
+	for (unsigned i = 0; i < settings.size(); ++i)
+		settings[i]->Prepare(conf);
+}
+
+void SettingsBase::CommitAll()
+{
+	std::vector<SettingsBase *> &settings = AllSettings();
+	for (unsigned i = 0; i < settings.size(); ++i)
+		settings[i]->Commit();
+}
+
 BotInfo *Conf::GetClient(const Anope::string &cname)
 {
 	Anope::map<Anope::string>::iterator it = bots.find(cname);
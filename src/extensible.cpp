@@ -8,16 +8,123 @@
 
 #include "extensible.h"
 
-static std::set<ExtensibleBase *> extensible_items;
+/* Extension items by slot, with holes left by items which have been destroyed */
+static std::vector<ExtensibleBase *> extensible_items;
+/* Extension items by name */
+static TR1NS::unordered_map<Anope::string, ExtensibleBase *, Anope::hash_cs> extensible_names;
+/* The first of the objects which have extensions set */
+static Extensible *extended_objects = NULL;
 
 ExtensibleBase::ExtensibleBase(Module *m, const Anope::string &n) : Service(m, "Extensible", n)
 {
-	extensible_items.insert(this);
+	std::vector<ExtensibleBase *>::iterator it = std::find(extensible_items.begin(), extensible_items.end(), static_cast<ExtensibleBase *>(NULL));
+	if (it != extensible_items.end())
+		*it = this;
+	else
+		it = extensible_items.insert(it, this);
+
+	this->slot = it - extensible_items.begin();
+	extensible_names[n] = this;
 }
 
 ExtensibleBase::~ExtensibleBase()
 {
-	extensible_items.erase(this);
+	extensible_items[this->slot] = NULL;
+	extensible_names.erase(this->name);
+}
+
+void ExtensibleBase::SetValue(Extensible *obj, void *value)
+{
+	std::vector<Extensible::Extension>::iterator it = obj->extensions.begin();
+	while (it != obj->extensions.end() && it->slot < this->slot)
+		++it;
+
+	Extensible::Extension ext;
+	ext.slot = this->slot;
+	ext.value = value;
+	obj->extensions.insert(it, ext);
+
+	if (obj->extensions.size() == 1)
+	{
+		obj->prev_extended = NULL;
+		obj->next_extended = extended_objects;
+		if (extended_objects)
+			extended_objects->prev_extended = obj;
+		extended_objects = obj;
+	}
+}
+
+void *ExtensibleBase::UnsetValue(Extensible *obj)
+{
+	for (std::vector<Extensible::Extension>::iterator it = obj->extensions.begin(), it_end = obj->extensions.end(); it != it_end && it->slot <= this->slot; ++it)
+	{
+		if (it->slot != this->slot)
+			continue;
+
+		void *value = it->value;
+		obj->extensions.erase(it);
+
+		if (obj->extensions.empty())
+		{
+			if (obj->prev_extended)
+				obj->prev_extended->next_extended = obj->next_extended;
+			else
+				extended_objects = obj->next_extended;
+			if (obj->next_extended)
+				obj->next_extended->prev_extended = obj->prev_extended;
+			obj->prev_extended = obj->next_extended = NULL;
+
+			/* Give back the memory of objects which no longer have extensions */
+			std::vector<Extensible::Extension>().swap(obj->extensions);
+		}
+
+		return value;
+	}
+
+	return NULL;
+}
+
+void ExtensibleBase::UnsetAll()
+{
+	/* Deleting a value may unset extensions of other objects, so rescan until none are left */
+	for (bool found = true; found;)
+	{
+		found = false;
+
+		for (Extensible *obj = extended_objects, *next; obj; obj = next)
+		{
+			next = obj->next_extended;
+
+			if (this->IsSet(obj))
+			{
+				this->Unset(obj);
+				found = true;
+			}
+		}
+	}
+}
+
+ExtensibleBase *ExtensibleBase::Find(const Anope::string &name)
+{
+	TR1NS::unordered_map<Anope::string, ExtensibleBase *, Anope::hash_cs>::const_iterator it = extensible_names.find(name);
+	if (it != extensible_names.end())
+		return it->second;
+
+	/* Not a registered name, but it may be an alias */
+	return static_cast<ExtensibleBase *>(Service::FindService("Extensible", name));
+}
+
+Extensible::Extensible() : prev_extended(NULL), next_extended(NULL)
+{
+}
+
+Extensible::Extensible(const Extensible &) : prev_extended(NULL), next_extended(NULL)
+{
+}
+
+Extensible &Extensible::operator=(const Extensible &)
+{
+	return *this;
 }
 
 Extensible::~Extensible()
@@ -27,15 +134,15 @@ Extensible::~Extensible()
 
 void Extensible::UnsetExtensibles()
 {
-	while (!extension_items.empty())
-		(*extension_items.begin())->Unset(this);
+	while (!extensions.empty())
+		extensible_items[extensions.back().slot]->Unset(this);
 }
 
 bool Extensible::HasExt(const Anope::string &name) const
 {
-	ExtensibleRef<void *> ref(name);
-	if (ref)
-		return ref->HasExt(this);
+	ExtensibleBase *item = ExtensibleBase::Find(name);
+	if (item)
+		return item->IsSet(this);
 
 	Log(LOG_DEBUG) << "HasExt for nonexistent type " << name << " on " << static_cast<const void *>(this);
 	return false;
@@ -43,28 +150,29 @@ bool Extensible::HasExt(const Anope::string &name) const
 
 void Extensible::ExtensibleSerialize(const Extensible *e, const Serializable *s, Serialize::Data &data)
 {
-	for (std::set<ExtensibleBase *>::iterator it = e->extension_items.begin(); it != e->extension_items.end(); ++it)
+	for (std::vector<Extension>::const_iterator it = e->extensions.begin(); it != e->extensions.end(); ++it)
 	{
-		ExtensibleBase *eb = *it;
+		ExtensibleBase *eb = extensible_items[it->slot];
 		eb->ExtensibleSerialize(e, s, data);
 	}
 }
 
 void Extensible::ExtensibleUnserialize(Extensible *e, Serializable *s, Serialize::Data &data)
 {
-	for (std::set<ExtensibleBase *>::iterator it = extensible_items.begin(); it != extensible_items.end(); ++it)
+	for (std::vector<ExtensibleBase *>::iterator it = extensible_items.begin(); it != extensible_items.end(); ++it)
 	{
 		ExtensibleBase *eb = *it;
-		eb->ExtensibleUnserialize(e, s, data);
+		if (eb)
+			eb->ExtensibleUnserialize(e, s, data);
 	}
 }
 
 template<>
 bool* Extensible::Extend(const Anope::string &name, const bool &what)
 {
-	ExtensibleRef<bool> ref(name);
-	if (ref)
-		return ref->Set(this);
+	BaseExtensibleItem<bool> *item = static_cast<BaseExtensibleItem<bool> *>(ExtensibleBase::Find(name));
+	if (item)
+		return item->Set(this);
 
 	Log(LOG_DEBUG) << "Extend for nonexistent type " << name << " on " << static_cast<void *>(this);
 	return NULL;
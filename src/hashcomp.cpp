@@ -27,6 +27,24 @@ void Anope::CaseMapRebuild()
 	}
 }
 
+size_t Anope::hash_ci::operator()(const Anope::string &s) const
+{
+	/* Generated the first time anything is hashed, and kept for as long as we run */
+	static char key[16];
+	static bool generated = false;
+
+	if (!generated)
+	{
+		unsigned seed = rand() ^ time(NULL);
+		for (size_t i = 0; i < sizeof(key); ++i)
+			key[i] = (seed >> (i % 4 * 8)) ^ rand();
+		generated = true;
+	}
+
+	/* Hash the lowercase form of each character rather than a lowercased copy of the string */
+	return Anope::SipHash24(s.c_str(), s.length(), key, case_map_lower);
+}
+
 unsigned char Anope::tolower(unsigned char c)
 {
 	return case_map_lower[c];
@@ -16,44 +16,252 @@
 #include "language.h"
 
 #if GETTEXT_FOUND
-# include <libintl.h>
+# include <fstream>
+# ifndef _WIN32
+#  include <iconv.h>
+#  include <langinfo.h>
+# endif
 #endif
 
 std::vector<Anope::string> Language::Languages;
 std::vector<Anope::string> Language::Domains;
 
+#if GETTEXT_FOUND
+namespace
+{
+	struct CStringHash
+	{
+		size_t operator()(const char *s) const
+		{
+			size_t h = 5381;
+			for (; *s; ++s)
+				h = (h * 33) ^ static_cast<unsigned char>(*s);
+			return h;
+		}
+	};
+
+	struct CStringEqual
+	{
+		bool operator()(const char *a, const char *b) const
+		{
+			return !strcmp(a, b);
+		}
+	};
+
+	/* The translations of one domain into one language, read from its .mo file.
+	 * This is never modified once loaded.
+	 */
+	class Catalog
+	{
+		/* The contents of the .mo file, the table points into this */
+		std::vector<char> data;
+		/* Translations converted to the character set of the language */
+		std::deque<std::string> converted;
+		TR1NS::unordered_map<const char *, const char *, CStringHash, CStringEqual> table;
+
+		uint32_t Get(size_t pos, bool swap) const
+		{
+			uint32_t i;
+			memcpy(&i, &data[pos], sizeof(i));
+			if (swap)
+				i = ((i & 0xFF) << 24) | ((i & 0xFF00) << 8) | ((i >> 8) & 0xFF00) | (i >> 24);
+			return i;
+		}
+
+		/* Finds the string described by the table entry at pos, or NULL if it is invalid */
+		const char *GetString(size_t pos, bool swap) const
+		{
+			if (pos + 8 > data.size())
+				return NULL;
+
+			uint32_t len = Get(pos, swap), offset = Get(pos + 4, swap);
+			if (offset >= data.size() || len >= data.size() - offset || data[offset + len] != '\0')
+				return NULL;
+			return &data[offset];
+		}
+
+	 public:
+		bool Load(const Anope::string &filename, const Anope::string &codeset)
+		{
+			std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+			if (!file.is_open())
+				return false;
+
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			if (data.size() < 20)
+				return false;
+
+			bool swap;
+			uint32_t magic = Get(0, false);
+			if (magic == 0x950412DE)
+				swap = false;
+			else if (magic == 0xDE120495)
+				swap = true;
+			else
+				return false;
+
+			uint32_t count = Get(8, swap), originals = Get(12, swap), translations = Get(16, swap);
+
+#ifndef _WIN32
+			iconv_t cd = reinterpret_cast<iconv_t>(-1);
+#endif
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const char *original = GetString(originals + static_cast<size_t>(i) * 8, swap), *translation = GetString(translations + static_cast<size_t>(i) * 8, swap);
+				if (!original || !translation || !*translation)
+					continue;
+
+				if (!*original)
+				{
+					/* The header, which tells us the character set of the translations */
+					Anope::string header = translation;
+					size_t pos = header.find("charset=");
+					if (pos == Anope::string::npos)
+						continue;
+					Anope::string charset = header.substr(pos + 8);
+					charset = charset.substr(0, charset.find_first_of(" \n;"));
+#ifndef _WIN32
+					if (!codeset.empty() && !charset.equals_ci(codeset) && (cd = iconv_open(codeset.c_str(), charset.c_str())) == reinterpret_cast<iconv_t>(-1))
+						Log() << "Unable to convert " << filename << " from " << charset << " to " << codeset;
+#endif
+					continue;
+				}
+
+#ifndef _WIN32
+				if (cd != reinterpret_cast<iconv_t>(-1))
+				{
+					size_t inleft = strlen(translation), outleft = inleft * 4;
+					std::vector<char> out(outleft + 1);
+					char *in = const_cast<char *>(translation), *outp = &out[0];
+					if (iconv(cd, &in, &inleft, &outp, &outleft) != static_cast<size_t>(-1))
+					{
+						*outp = '\0';
+						converted.push_back(&out[0]);
+						translation = converted.back().c_str();
+					}
+					iconv(cd, NULL, NULL, NULL, NULL);
+				}
+#endif
+
+				table[original] = translation;
+			}
+#ifndef _WIN32
+			if (cd != reinterpret_cast<iconv_t>(-1))
+				iconv_close(cd);
+#endif
+
+			return true;
+		}
+
+		const char *Find(const char *string) const
+		{
+			TR1NS::unordered_map<const char *, const char *, CStringHash, CStringEqual>::const_iterator it = table.find(string);
+			return it != table.end() ? it->second : NULL;
+		}
+	};
+
+	/* The catalogs for one language, the anope domain first then modules' domains */
+	struct LanguageCatalogs
+	{
+		Anope::string name;
+		std::vector<Catalog *> catalogs;
+
+		~LanguageCatalogs()
+		{
+			for (unsigned i = 0; i < catalogs.size(); ++i)
+				delete catalogs[i];
+		}
+	};
+
+	std::vector<LanguageCatalogs *> Catalogs;
+
+	/* Gets the character set translations into lang should be in */
+	Anope::string GetCodeset(const Anope::string &lang)
+	{
+		Anope::string codeset;
+#ifndef _WIN32
+		if (setlocale(LC_ALL, lang.c_str()) != NULL)
+			codeset = nl_langinfo(CODESET);
+		setlocale(LC_ALL, "");
+#endif
+		return codeset;
+	}
+}
+
+void Language::LoadCatalogs()
+{
+	std::vector<Anope::string> domains;
+	domains.push_back("anope");
+	domains.insert(domains.end(), Domains.begin(), Domains.end());
+
+	std::vector<LanguageCatalogs *> new_catalogs;
+	for (unsigned i = 0; i < Languages.size(); ++i)
+	{
+		LanguageCatalogs *lc = new LanguageCatalogs();
+		lc->name = Languages[i];
+		new_catalogs.push_back(lc);
+
+		/* Remove .UTF-8 or any other suffix */
+		Anope::string lang;
+		sepstream(Languages[i], '.').GetToken(lang);
+
+		const Anope::string codeset = GetCodeset(Languages[i]);
+		for (unsigned j = 0; j < domains.size(); ++j)
+		{
+			Catalog *c = new Catalog();
+			if (c->Load(Anope::LocaleDir + "/" + lang + "/LC_MESSAGES/" + domains[j] + ".mo", codeset))
+				lc->catalogs.push_back(c);
+			else
+				delete c;
+		}
+	}
+
+	Catalogs.swap(new_catalogs);
+	for (unsigned i = 0; i < new_catalogs.size(); ++i)
+		delete new_catalogs[i];
+}
+
 void Language::InitLanguages()
 {
-#if GETTEXT_FOUND
 	Log(LOG_DEBUG) << "Initializing Languages...";
 
 	Languages.clear();
 
-	if (!bindtextdomain("anope", Anope::LocaleDir.c_str()))
-		Log() << "Error calling bindtextdomain, " << Anope::LastError();
-	else
-		Log(LOG_DEBUG) << "Successfully bound anope to " << Anope::LocaleDir;
-
 	setlocale(LC_ALL, "");
 
 	spacesepstream sep(Config->GetBlock("options")->Get<const Anope::string>("languages"));
 	Anope::string language;
 	while (sep.GetToken(language))
+		Languages.push_back(language);
+
+	/* Every configured language is loaded, the ones without translations are then dropped */
+	LoadCatalogs();
+
+	std::vector<Anope::string> configured;
+	configured.swap(Languages);
+	for (unsigned i = 0; i < configured.size(); ++i)
 	{
-		const Anope::string &lang_name = Translate(language.c_str(), _("English"));
+		const Anope::string &lang_name = Translate(configured[i].c_str(), _("English"));
 		if (lang_name == "English")
 		{
-			Log() << "Unable to use language " << language;
+			Log() << "Unable to use language " << configured[i];
 			continue;
 		}
 
-		Log(LOG_DEBUG) << "Found language " << language;
-		Languages.push_back(language);
+		Log(LOG_DEBUG) << "Found language " << configured[i];
+		Languages.push_back(configured[i]);
 	}
+}
 #else
+void Language::LoadCatalogs()
+{
+}
+
+void Language::InitLanguages()
+{
 	Log() << "Unable to initialize languages, gettext is not installed";
-#endif
 }
+#endif
 
 const char *Language::Translate(const char *string)
 {
@@ -74,11 +282,6 @@ const char *Language::Translate(const NickCore *nc, const char *string)
 }
 
 #if GETTEXT_FOUND
-
-#if defined(__GLIBC__) && defined(__USE_GNU_GETTEXT)
-extern "C" int _nl_msg_cat_cntr;
-#endif
-
 const char *Language::Translate(const char *lang, const char *string)
 {
 	if (!string || !*string)
@@ -87,37 +290,22 @@ const char *Language::Translate(const char *lang, const char *string)
 	if (!lang || !*lang)
 		lang = Config->DefLanguage.c_str();
 
-#if defined(__GLIBC__) && defined(__USE_GNU_GETTEXT)
-	++_nl_msg_cat_cntr;
-#endif
+	for (unsigned i = 0; i < Catalogs.size(); ++i)
+	{
+		const LanguageCatalogs *lc = Catalogs[i];
+		if (lc->name != lang)
+			continue;
 
-#ifdef _WIN32
-	SetThreadLocale(MAKELCID(MAKELANGID(WindowsGetLanguage(lang), SUBLANG_DEFAULT), SORT_DEFAULT));
-#else
-	/* First, set LANG and LANGUAGE env variables.
-	 * Some systems (Debian) don't care about this, so we must setlocale LC_ALL as well.
-	 * BUT if this call fails because the LANGUAGE env variable is set, setlocale resets
-	 * the locale to "C", which short circuits gettext and causes it to fail on systems that
-	 * use the LANGUAGE env variable. We must reset the locale to en_US (or, anything not
-	 * C or POSIX) then.
-	 */
-	setenv("LANG", lang, 1);
-	setenv("LANGUAGE", lang, 1);
-	if (setlocale(LC_ALL, lang) == NULL)
-		setlocale(LC_ALL, "en_US");
-#endif
-	const char *translated_string = dgettext("anope", string);
-	for (unsigned i = 0; translated_string == string && i < Domains.size(); ++i)
-		translated_string = dgettext(Domains[i].c_str(), string);
-#ifdef _WIN32
-	SetThreadLocale(MAKELCID(MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), SORT_DEFAULT));
-#else
-	unsetenv("LANGUAGE");
-	unsetenv("LANG");
-	setlocale(LC_ALL, "");
-#endif
+		for (unsigned j = 0; j < lc->catalogs.size(); ++j)
+		{
+			const char *translated_string = lc->catalogs[j]->Find(string);
+			if (translated_string)
+				return translated_string;
+		}
+		break;
+	}
 
-	return translated_string;
+	return string;
 }
 #else
 const char *Language::Translate(const char *lang, const char *string)
@@ -15,6 +15,7 @@
 #include "bots.h"
 #include "socketengine.h"
 #include "uplink.h"
+#include "threadengine.h"
 
 #ifndef _WIN32
 #include <limits.h>
@@ -155,7 +156,6 @@ int main(int ac, char **av, char **envp)
 	}
 
 	/* Set up timers */
-	time_t last_check = Anope::CurTime;
 	UpdateTimer updateTimer(Config->GetBlock("options")->Get<time_t>("updatetimeout", "5m"));
 	ExpireTimer expireTimer(Config->GetBlock("options")->Get<time_t>("expiretimeout", "30m"));
 
@@ -165,11 +165,7 @@ int main(int ac, char **av, char **envp)
 		Log(LOG_DEBUG_2) << "Top of main loop";
 
 		/* Process timers */
-		if (Anope::CurTime - last_check >= Config->TimeoutCheck)
-		{
-			TimerManager::TickTimers(Anope::CurTime);
-			last_check = Anope::CurTime;
-		}
+		TimerManager::TickTimers(Anope::CurTime);
 
 		/* Process the socket engine */
 		SocketEngine::Process();
@@ -194,6 +190,7 @@ int main(int ac, char **av, char **envp)
 	delete UplinkSock;
 
 	ModuleManager::UnloadAll();
+	WorkerPool::Shutdown();
 	SocketEngine::Shutdown();
 	for (Module *m; (m = ModuleManager::FindFirstOf(PROTOCOL)) != NULL;)
 		ModuleManager::UnloadModule(m, NULL);
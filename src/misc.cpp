@@ -27,6 +27,108 @@
 #include <netdb.h>
 #endif
 
+/* The expression and the engine used to compile it */
+typedef std::pair<Anope::string, Anope::string> RegexCacheKey;
+
+struct RegexCacheEntry
+{
+	/* NULL if the expression failed to compile */
+	Regex *regex;
+	RegexProvider *provider;
+	std::list<RegexCacheKey>::iterator lru;
+};
+
+/* The maximum number of compiled expressions kept by Anope::Match */
+static const size_t RegexCacheSize = 128;
+static std::map<RegexCacheKey, RegexCacheEntry> RegexCache;
+/* Keys of the cache, most recently used first */
+static std::list<RegexCacheKey> RegexCacheLRU;
+static unsigned long RegexCacheHits = 0, RegexCacheMisses = 0;
+
+struct MatchSettings
+{
+	/* options:regexengine */
+	Anope::string regexengine;
+};
+
+static class MatchOptions : public Configuration::Settings<MatchSettings>
+{
+ public:
+	MatchOptions() : Configuration::Settings<MatchSettings>("options")
+	{
+		this->Bind(&MatchSettings::regexengine, "regexengine");
+	}
+} match_options;
+
+static Regex *GetCachedRegex(const Anope::string &engine, const Anope::string &expression)
+{
+	RegexCacheKey key(expression, engine);
+
+	std::map<RegexCacheKey, RegexCacheEntry>::iterator it = RegexCache.find(key);
+	if (it != RegexCache.end())
+	{
+		++RegexCacheHits;
+		RegexCacheLRU.splice(RegexCacheLRU.begin(), RegexCacheLRU, it->second.lru);
+		return it->second.regex;
+	}
+
+	ServiceReference<RegexProvider> provider("Regex", engine);
+	if (!provider)
+		return NULL;
+
+	++RegexCacheMisses;
+
+	RegexCacheEntry entry;
+	entry.regex = NULL;
+	entry.provider = provider;
+	try
+	{
+		entry.regex = provider->Compile(expression);
+	}
+	catch (const RegexException &ex)
+	{
+		Log(LOG_DEBUG) << ex.GetReason();
+	}
+
+	RegexCacheLRU.push_front(key);
+	entry.lru = RegexCacheLRU.begin();
+	RegexCache[key] = entry;
+
+	if (RegexCache.size() > RegexCacheSize)
+	{
+		it = RegexCache.find(RegexCacheLRU.back());
+		delete it->second.regex;
+		RegexCache.erase(it);
+		RegexCacheLRU.pop_back();
+	}
+
+	return entry.regex;
+}
+
+void Anope::ClearRegexCache(RegexProvider *provider)
+{
+	for (std::map<RegexCacheKey, RegexCacheEntry>::iterator it = RegexCache.begin(); it != RegexCache.end();)
+	{
+		RegexCacheEntry &entry = it->second;
+		++it;
+
+		if (provider && entry.provider != provider)
+			continue;
+
+		RegexCacheKey key = *entry.lru;
+		delete entry.regex;
+		RegexCacheLRU.erase(entry.lru);
+		RegexCache.erase(key);
+	}
+}
+
+void Anope::GetRegexCacheStats(size_t &entries, unsigned long &hits, unsigned long &misses)
+{
+	entries = RegexCache.size();
+	hits = RegexCacheHits;
+	misses = RegexCacheMisses;
+}
+
 NumberList::NumberList(const Anope::string &list, bool descending) : is_valid(true), desc(descending)
 {
 	Anope::string error;
@@ -403,6 +505,14 @@ Anope::string Anope::Expires(time_t expires, const NickCore *nc)
 	}
 }
 
+Anope::string Anope::GetMatchPrefix(const Anope::string &mask)
+{
+	if (mask.length() >= 2 && mask[0] == '/' && mask[mask.length() - 1] == '/')
+		return "";
+
+	return mask.substr(0, mask.find_first_of("*?"));
+}
+
 bool Anope::Match(const Anope::string &str, const Anope::string &mask, bool case_sensitive, bool use_regex)
 {
 	size_t s = 0, m = 0, str_len = str.length(), mask_len = mask.length();
@@ -410,32 +520,8 @@ bool Anope::Match(const Anope::string &str, const Anope::string &mask, bool case
 	if (use_regex && mask_len >= 2 && mask[0] == '/' && mask[mask.length() - 1] == '/')
 	{
 		Anope::string stripped_mask = mask.substr(1, mask_len - 2);
-		// This is often called with the same mask multiple times in a row, so cache it
-		static Regex *r = NULL;
-
-		if (r == NULL || r->GetExpression() != stripped_mask)
-		{
-			ServiceReference<RegexProvider> provider("Regex", Config->GetBlock("options")->Get<const Anope::string>("regexengine"));
-			if (provider)
-			{
-				try
-				{
-					delete r;
-					r = NULL;
-					// This may throw
-					r = provider->Compile(stripped_mask);
-				}
-				catch (const RegexException &ex)
-				{
-					Log(LOG_DEBUG) << ex.GetReason();
-				}
-			}
-			else
-			{
-				delete r;
-				r = NULL;
-			}
-		}
+		// This is often called with the same masks over and over, so the compiled expressions are cached
+		Regex *r = GetCachedRegex(match_options->regexengine, stripped_mask);
 
 		if (r != NULL && r->Matches(str))
 			return true;
@@ -30,8 +30,8 @@ static std::vector<UserMode *> UserModes;
 static std::vector<ChannelMode *> ChannelModesIdx;
 static std::vector<UserMode *> UserModesIdx;
 
-static std::map<Anope::string, ChannelMode *> ChannelModesByName;
-static std::map<Anope::string, UserMode *> UserModesByName;
+static TR1NS::unordered_map<Anope::string, ChannelMode *, Anope::hash_cs> ChannelModesByName;
+static TR1NS::unordered_map<Anope::string, UserMode *, Anope::hash_cs> UserModesByName;
 
 /* Sorted by status */
 static std::vector<ChannelModeStatus *> ChannelModesByStatus;
@@ -547,7 +547,7 @@ UserMode *ModeManager::FindUserModeByChar(char mode)
 
 ChannelMode *ModeManager::FindChannelModeByName(const Anope::string &name)
 {
-	std::map<Anope::string, ChannelMode *>::iterator it = ChannelModesByName.find(name);
+	TR1NS::unordered_map<Anope::string, ChannelMode *, Anope::hash_cs>::iterator it = ChannelModesByName.find(name);
 	if (it != ChannelModesByName.end())
 		return it->second;
 	return NULL;
@@ -555,7 +555,7 @@ ChannelMode *ModeManager::FindChannelModeByName(const Anope::string &name)
 
 UserMode *ModeManager::FindUserModeByName(const Anope::string &name)
 {
-	std::map<Anope::string, UserMode *>::iterator it = UserModesByName.find(name);
+	TR1NS::unordered_map<Anope::string, UserMode *, Anope::hash_cs>::iterator it = UserModesByName.find(name);
 	if (it != UserModesByName.end())
 		return it->second;
 	return NULL;
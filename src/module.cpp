@@ -10,10 +10,7 @@
 #include "modules.h"
 #include "language.h"
 #include "account.h"
-
-#ifdef GETTEXT_FOUND
-# include <libintl.h>
-#endif
+#include "threadengine.h"
 
 Module::Module(const Anope::string &modname, const Anope::string &, ModType modtype) : name(modname), type(modtype)
 {
@@ -48,13 +45,9 @@ Module::Module(const Anope::string &modname, const Anope::string &, ModType modt
 
 		if (Anope::IsFile(Anope::LocaleDir + "/" + lang + "/LC_MESSAGES/" + modname + ".mo"))
 		{
-			if (!bindtextdomain(this->name.c_str(), Anope::LocaleDir.c_str()))
-				Log() << "Error calling bindtextdomain, " << Anope::LastError();
-			else
-			{
-				Log() << "Found language file " << lang << " for " << modname;
-				Language::Domains.push_back(modname);
-			}
+			Log() << "Found language file " << lang << " for " << modname;
+			Language::Domains.push_back(modname);
+			Language::LoadCatalogs();
 			break;
 		}
 	}
@@ -67,6 +60,8 @@ Module::~Module()
 
 	/* Detach all event hooks for this module */
 	ModuleManager::DetachAll(this);
+	/* Discard any work this module has queued */
+	WorkerPool::ModuleUnload(this);
 	IdentifyRequest::ModuleUnload(this);
 	/* Clear any active timers this module has */
 	TimerManager::DeleteTimersFor(this);
@@ -78,7 +73,10 @@ Module::~Module()
 #if GETTEXT_FOUND
 	std::vector<Anope::string>::iterator dit = std::find(Language::Domains.begin(), Language::Domains.end(), this->name);
 	if (dit != Language::Domains.end())
+	{
 		Language::Domains.erase(dit);
+		Language::LoadCatalogs();
+	}
 #endif
 }
 
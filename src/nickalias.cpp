@@ -17,8 +17,10 @@
 #include "users.h"
 #include "servers.h"
 #include "config.h"
+#include "regchannel.h"
 
 Serialize::Checker<nickalias_map> NickAliasList("NickAlias");
+Serialize::Checker<nickalias_index> NickAliasIndex("NickAlias");
 
 NickAlias::NickAlias(const Anope::string &nickname, NickCore* nickcore) : Serializable("NickAlias")
 {
@@ -34,6 +36,7 @@ NickAlias::NickAlias(const Anope::string &nickname, NickCore* nickcore) : Serial
 
 	size_t old = NickAliasList->size();
 	(*NickAliasList)[this->nick] = this;
+	(*NickAliasIndex)[this->nick] = this;
 	if (old == NickAliasList->size())
 		Log(LOG_DEBUG) << "Duplicate nick " << nickname << " in nickalias table";
 
@@ -46,6 +49,9 @@ NickAlias::NickAlias(const Anope::string &nickname, NickCore* nickcore) : Serial
 		if (this->nc->o != NULL)
 			Log() << "Tied oper " << this->nc->display << " to type " << this->nc->o->ot->GetName();
 	}
+
+	/* Channel access entries for this nick now resolve to this account */
+	ChannelInfo::ClearAccessCache();
 }
 
 NickAlias::~NickAlias()
@@ -54,6 +60,8 @@ NickAlias::~NickAlias()
 
 	UnsetExtensibles();
 
+	ChannelInfo::ClearAccessCache();
+
 	/* Accept nicks that have no core, because of database load functions */
 	if (this->nc)
 	{
@@ -76,6 +84,7 @@ NickAlias::~NickAlias()
 
 	/* Remove us from the aliases list */
 	NickAliasList->erase(this->nick);
+	NickAliasIndex->erase(this->nick);
 }
 
 void NickAlias::SetVhost(const Anope::string &ident, const Anope::string &host, const Anope::string &creator, time_t created)
@@ -183,6 +192,7 @@ Serializable* NickAlias::Unserialize(Serializable *obj, Serialize::Data &data)
 
 		na->nc = core;
 		core->aliases->push_back(na);
+		ChannelInfo::ClearAccessCache();
 	}
 
 	data["last_quit"] >> na->last_quit;
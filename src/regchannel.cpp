@@ -20,6 +20,13 @@
 #include "servers.h"
 
 Serialize::Checker<registered_channel_map> RegisteredChannelList("ChannelInfo");
+Serialize::Checker<registered_channel_index> RegisteredChannelIndex("ChannelInfo");
+
+/* The current generation of access entries, see ChannelInfo::ClearAccessCache */
+static uint64_t ChannelAccessGeneration = 1;
+/* The most users whose access is cached on one channel */
+static const size_t AccessCacheSize = 1024;
+static unsigned long AccessCacheHits = 0, AccessCacheMisses = 0;
 
 AutoKick::AutoKick() : Serializable("AutoKick")
 {
@@ -109,6 +116,7 @@ ChannelInfo::ChannelInfo(const Anope::string &chname) : Serializable("ChannelInf
 	this->banexpire = 0;
 	this->bi = NULL;
 	this->last_topic_time = 0;
+	this->access_cache_generation = 0;
 
 	this->name = chname;
 
@@ -118,9 +126,13 @@ ChannelInfo::ChannelInfo(const Anope::string &chname) : Serializable("ChannelInf
 
 	size_t old = RegisteredChannelList->size();
 	(*RegisteredChannelList)[this->name] = this;
+	(*RegisteredChannelIndex)[this->name] = this;
 	if (old == RegisteredChannelList->size())
 		Log(LOG_DEBUG) << "Duplicate channel " << this->name << " in registered channel table?";
 
+	/* Access entries on other channels may refer to this one */
+	ClearAccessCache();
+
 	FOREACH_MOD(OnCreateChan, (this));
 }
 
@@ -134,6 +146,7 @@ ChannelInfo::ChannelInfo(const ChannelInfo &ci) : Serializable("ChannelInfo"),
 
 	this->access->clear();
 	this->akick->clear();
+	this->access_cache.clear();
 
 	FOREACH_MOD(OnCreateChan, (this));
 }
@@ -146,6 +159,8 @@ ChannelInfo::~ChannelInfo()
 
 	Log(LOG_DEBUG) << "Deleting channel " << this->name;
 
+	ClearAccessCache();
+
 	if (this->c)
 	{
 		if (this->bi && this->c->FindUser(this->bi))
@@ -163,6 +178,7 @@ ChannelInfo::~ChannelInfo()
 	}
 
 	RegisteredChannelList->erase(this->name);
+	RegisteredChannelIndex->erase(this->name);
 
 	this->SetFounder(NULL);
 	this->SetSuccessor(NULL);
@@ -240,9 +256,16 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 		for (unsigned i = 0; i + 1 < v.size(); i += 2)
 			try
 			{
-				ci->levels[v[i]] = convertTo<int16_t>(v[i + 1]);
+				int16_t level = convertTo<int16_t>(v[i + 1]);
+				unsigned privid = PrivilegeManager::GetID(v[i]);
+
+				ci->levels[v[i]] = level;
+				if (privid >= ci->level_ids.size())
+					ci->level_ids.resize(privid + 1);
+				ci->level_ids[privid] = level;
 			}
 			catch (const ConvertException &) { }
+		PrivilegeManager::Invalidate();
 	}
 	BotInfo *bi = BotInfo::Find(sbi, true);
 	if (*ci->bi != bi)
@@ -371,6 +394,7 @@ BotInfo *ChannelInfo::WhoSends() const
 void ChannelInfo::AddAccess(ChanAccess *taccess)
 {
 	this->access->push_back(taccess);
+	ClearAccessCache();
 }
 
 ChanAccess *ChannelInfo::GetAccess(unsigned index) const
@@ -436,7 +460,34 @@ AccessGroup ChannelInfo::AccessFor(const User *u, bool updateLastUsed)
 	group.ci = this;
 	group.nc = nc;
 
-	FindMatches(group, this, u, u->Account());
+	/* The cache doesn't look at the access list, so make sure it is up to date first */
+	this->access.Check();
+
+	if (this->access_cache_generation != ChannelAccessGeneration)
+	{
+		this->access_cache.clear();
+		this->access_cache_generation = ChannelAccessGeneration;
+	}
+
+	std::map<uint64_t, std::vector<ChanAccess::Path> >::iterator it = this->access_cache.find(u->GetAccessGeneration());
+	if (it != this->access_cache.end())
+	{
+		++AccessCacheHits;
+		group.paths = it->second;
+	}
+	else
+	{
+		++AccessCacheMisses;
+		FindMatches(group, this, u, u->Account());
+
+		/* Looking through the access lists may have caused them to be reloaded */
+		if (this->access_cache_generation == ChannelAccessGeneration)
+		{
+			if (this->access_cache.size() >= AccessCacheSize)
+				this->access_cache.clear();
+			this->access_cache[u->GetAccessGeneration()] = group.paths;
+		}
+	}
 
 	if (group.founder || !group.paths.empty())
 	{
@@ -474,6 +525,17 @@ AccessGroup ChannelInfo::AccessFor(const NickCore *nc, bool updateLastUsed)
 	return group;
 }
 
+void ChannelInfo::ClearAccessCache()
+{
+	++ChannelAccessGeneration;
+}
+
+void ChannelInfo::GetAccessCacheStats(unsigned long &hits, unsigned long &misses)
+{
+	hits = AccessCacheHits;
+	misses = AccessCacheMisses;
+}
+
 unsigned ChannelInfo::GetAccessCount() const
 {
 	return this->access->size();
@@ -516,6 +578,7 @@ ChanAccess *ChannelInfo::EraseAccess(unsigned index)
 
 	ChanAccess *ca = this->access->at(index);
 	this->access->erase(this->access->begin() + index);
+	ClearAccessCache();
 	return ca;
 }
 
@@ -594,37 +657,56 @@ const Anope::map<int16_t> &ChannelInfo::GetLevelEntries()
 
 int16_t ChannelInfo::GetLevel(const Anope::string &priv) const
 {
-	if (PrivilegeManager::FindPrivilege(priv) == NULL)
+	const Privilege *p = PrivilegeManager::FindPrivilege(priv);
+	if (p == NULL)
 	{
 		Log(LOG_DEBUG) << "Unknown privilege " + priv;
 		return ACCESS_INVALID;
 	}
 
-	Anope::map<int16_t>::const_iterator it = this->levels.find(priv);
-	if (it == this->levels.end())
+	return this->GetLevel(p->id);
+}
+
+int16_t ChannelInfo::GetLevel(unsigned privid) const
+{
+	if (PrivilegeManager::FindPrivilege(privid) == NULL)
+		return ACCESS_INVALID;
+
+	if (privid >= this->level_ids.size())
 		return 0;
-	return it->second;
+	return this->level_ids[privid];
 }
 
 void ChannelInfo::SetLevel(const Anope::string &priv, int16_t level)
 {
-	if (PrivilegeManager::FindPrivilege(priv) == NULL)
+	const Privilege *p = PrivilegeManager::FindPrivilege(priv);
+	if (p == NULL)
 	{
 		Log(LOG_DEBUG) << "Unknown privilege " + priv;
 		return;
 	}
 
 	this->levels[priv] = level;
+	if (p->id >= this->level_ids.size())
+		this->level_ids.resize(p->id + 1);
+	this->level_ids[p->id] = level;
+	PrivilegeManager::Invalidate();
 }
 
 void ChannelInfo::RemoveLevel(const Anope::string &priv)
 {
 	this->levels.erase(priv);
+	unsigned privid = PrivilegeManager::GetID(priv);
+	if (privid < this->level_ids.size())
+		this->level_ids[privid] = 0;
+	PrivilegeManager::Invalidate();
 }
 
 void ChannelInfo::ClearLevels()
 {
 	this->levels.clear();
+	this->level_ids.clear();
+	PrivilegeManager::Invalidate();
 }
 
 Anope::string ChannelInfo::GetIdealBan(User *u) const
@@ -137,3 +137,41 @@ uint64_t Anope::SipHash24(const void *src, unsigned long src_sz, const char key[
 	DOUBLE_ROUND(v0,v1,v2,v3);
 	return (v0 ^ v1) ^ (v2 ^ v3);
 }
+
+uint64_t Anope::SipHash24(const void *src, unsigned long src_sz, const char key[16], const unsigned char map[256])
+{
+	const uint64_t *_key = (uint64_t *)key;
+	uint64_t k0 = _le64toh(_key[0]);
+	uint64_t k1 = _le64toh(_key[1]);
+	uint64_t b = (uint64_t)src_sz << 56;
+	const uint8_t *in = (const uint8_t *)src;
+
+	uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+	uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+	uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+	uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+	// Build each little endian word from the mapped bytes rather than loading it.
+	while (src_sz >= 8)
+	{
+		uint64_t mi = 0;
+		for (int i = 7; i >= 0; --i)
+			mi = (mi << 8) | map[in[i]];
+		in += 8; src_sz -= 8;
+		v3 ^= mi;
+		DOUBLE_ROUND(v0,v1,v2,v3);
+		v0 ^= mi;
+	}
+
+	uint64_t t = 0;
+	for (int i = src_sz - 1; i >= 0; --i)
+		t = (t << 8) | map[in[i]];
+	b |= t;
+
+	v3 ^= b;
+	DOUBLE_ROUND(v0,v1,v2,v3);
+	v0 ^= b; v2 ^= 0xff;
+	DOUBLE_ROUND(v0,v1,v2,v3);
+	DOUBLE_ROUND(v0,v1,v2,v3);
+	return (v0 ^ v1) ^ (v2 ^ v3);
+}
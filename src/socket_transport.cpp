@@ -13,7 +13,7 @@
 #include "sockets.h"
 #include "socketengine.h"
 
-BufferedSocket::BufferedSocket()
+BufferedSocket::BufferedSocket() : read_offset(0), write_offset(0), recv_len(0)
 {
 }
 
@@ -33,8 +33,15 @@ bool BufferedSocket::ProcessRead()
 	if (len < 0)
 		return SocketEngine::IgnoreErrno();
 
+	/* Drop the lines which have already been read, once per recv() rather than once per line */
+	if (this->read_offset)
+	{
+		this->read_buffer.erase(0, this->read_offset);
+		this->read_offset = 0;
+	}
+
 	tbuffer[len] = 0;
-	this->read_buffer.append(tbuffer);
+	this->read_buffer += tbuffer;
 	this->recv_len = len;
 
 	return true;
@@ -42,33 +49,53 @@ bool BufferedSocket::ProcessRead()
 
 bool BufferedSocket::ProcessWrite()
 {
-	int count = this->io->Send(this, this->write_buffer);
+	int count = this->io->Send(this, this->write_buffer.c_str() + this->write_offset, this->write_buffer.length() - this->write_offset);
 	if (count == 0)
 		return false;
 	if (count < 0)
 		return SocketEngine::IgnoreErrno();
 
-	this->write_buffer = this->write_buffer.substr(count);
-	if (this->write_buffer.empty())
+	this->write_offset += count;
+	if (this->write_offset >= this->write_buffer.length())
+	{
+		this->write_buffer.clear();
+		this->write_offset = 0;
 		SocketEngine::Change(this, false, SF_WRITABLE);
+	}
+	else if (this->write_offset > this->write_buffer.length() / 2)
+	{
+		/* Only move what's left to the front once most of the buffer has been sent */
+		this->write_buffer.erase(0, this->write_offset);
+		this->write_offset = 0;
+	}
 
 	return true;
 }
 
 const Anope::string BufferedSocket::GetLine()
 {
-	size_t s = this->read_buffer.find('\n');
+	size_t s = this->read_buffer.find('\n', this->read_offset);
 	if (s == Anope::string::npos)
 		return "";
-	Anope::string str = this->read_buffer.substr(0, s + 1);
-	this->read_buffer.erase(0, s + 1);
-	this->read_buffer.ltrim("\r\n");
-	return str.trim("\r\n");
+
+	size_t start = this->read_offset, end = s;
+	while (start < end && (this->read_buffer[start] == '\r' || this->read_buffer[start] == '\n'))
+		++start;
+	while (end > start && (this->read_buffer[end - 1] == '\r' || this->read_buffer[end - 1] == '\n'))
+		--end;
+
+	/* Skip past the line and any blank lines after it, the buffer is compacted on the next read */
+	this->read_offset = s + 1;
+	while (this->read_offset < this->read_buffer.length() && (this->read_buffer[this->read_offset] == '\r' || this->read_buffer[this->read_offset] == '\n'))
+		++this->read_offset;
+
+	return this->read_buffer.substr(start, end - start);
 }
 
 void BufferedSocket::Write(const char *buffer, size_t l)
 {
-	this->write_buffer += buffer + Anope::string("\r\n");
+	this->write_buffer += buffer;
+	this->write_buffer += "\r\n";
 	SocketEngine::Change(this, true, SF_WRITABLE);
 }
 
@@ -99,7 +126,7 @@ int BufferedSocket::ReadBufferLen() const
 
 int BufferedSocket::WriteBufferLen() const
 {
-	return this->write_buffer.length();
+	return this->write_buffer.length() - this->write_offset;
 }
 
 
@@ -15,6 +15,7 @@
 #include "socketengine.h"
 #include "logger.h"
 #include "config.h"
+#include "timers.h"
 
 #ifdef _AIX
 # undef FD_ZERO
@@ -85,8 +86,9 @@ void SocketEngine::Process()
 {
 	fd_set rfdset = ReadFDs, wfdset = WriteFDs, efdset = ReadFDs;
 	timeval tval;
-	tval.tv_sec = Config->ReadTimeout;
-	tval.tv_usec = 0;
+	long timeout = TimerManager::GetTimeout(Config->ReadTimeout * 1000);
+	tval.tv_sec = timeout / 1000;
+	tval.tv_usec = (timeout % 1000) * 1000;
 
 #ifdef _WIN32
 	/* We can use the socket engine to "sleep" services for a period of
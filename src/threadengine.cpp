@@ -12,6 +12,8 @@
 #include "services.h"
 #include "threadengine.h"
 #include "anope.h"
+#include "config.h"
+#include "logger.h"
 
 #ifndef _WIN32
 #include <pthread.h>
@@ -134,3 +136,194 @@ void Condition::Wait()
 {
 	pthread_cond_wait(&cond, &mutex);
 }
+
+class WorkerPool::Worker : public Thread
+{
+ public:
+	WorkerPool *pool;
+	/* Held by the worker while it is running a task */
+	Mutex running;
+	/* The task being run, protected by the pool's lock */
+	Task *current;
+
+	Worker(WorkerPool *p) : pool(p), current(NULL) { }
+
+	void Run() anope_override
+	{
+		pool->Work(this);
+	}
+};
+
+WorkerPool *WorkerPool::pool = NULL;
+
+WorkerPool::WorkerPool(unsigned threads) : exiting(false)
+{
+	for (unsigned i = 0; i < threads; ++i)
+	{
+		Worker *w = new Worker(this);
+		try
+		{
+			w->Start();
+		}
+		catch (const CoreException &ex)
+		{
+			/* The socket engine deletes threads which failed to start */
+			Log() << "Unable to start worker thread: " << ex.GetReason();
+			break;
+		}
+		workers.push_back(w);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	this->Lock();
+	exiting = true;
+	for (unsigned i = 0; i < workers.size(); ++i)
+		this->Wakeup();
+	this->Unlock();
+
+	for (unsigned i = 0; i < workers.size(); ++i)
+	{
+		workers[i]->Join();
+		delete workers[i];
+	}
+
+	for (unsigned i = 0; i < pending.size(); ++i)
+		delete pending[i];
+	for (unsigned i = 0; i < finished.size(); ++i)
+		delete finished[i];
+}
+
+void WorkerPool::Work(Worker *w)
+{
+	for (;;)
+	{
+		this->Lock();
+		while (pending.empty() && !exiting)
+			this->Wait();
+		if (exiting)
+		{
+			this->Unlock();
+			return;
+		}
+
+		Task *t = pending.front();
+		pending.pop_front();
+		w->current = t;
+		/* Taken before unlocking so ModuleUnload always sees a running task as locked */
+		w->running.Lock();
+		this->Unlock();
+
+		t->Run();
+
+		this->Lock();
+		w->current = NULL;
+		finished.push_back(t);
+		this->Unlock();
+		w->running.Unlock();
+
+		this->Notify();
+	}
+}
+
+bool WorkerPool::ProcessRead()
+{
+	/* Drain the pipe before completing tasks so a notification sent while
+	 * OnNotify runs is not lost
+	 */
+	char dummy[512];
+	while (this->Read(dummy, sizeof(dummy)) == sizeof(dummy));
+
+	this->OnNotify();
+	return true;
+}
+
+void WorkerPool::OnNotify()
+{
+	std::deque<Task *> done;
+	this->Lock();
+	done.swap(finished);
+	this->Unlock();
+
+	for (unsigned i = 0; i < done.size(); ++i)
+	{
+		done[i]->OnComplete();
+		delete done[i];
+	}
+}
+
+void WorkerPool::Queue(Task *t)
+{
+	if (pool == NULL)
+	{
+		unsigned threads = Config->GetBlock("options")->Get<unsigned>("workerthreads", "2");
+		pool = new WorkerPool(threads ? threads : 1);
+	}
+
+	if (pool->workers.empty())
+	{
+		/* No threads could be started, do the work now */
+		t->Run();
+		t->OnComplete();
+		delete t;
+		return;
+	}
+
+	pool->Lock();
+	pool->pending.push_back(t);
+	pool->Wakeup();
+	pool->Unlock();
+}
+
+void WorkerPool::ModuleUnload(Module *m)
+{
+	if (pool == NULL)
+		return;
+
+	std::vector<Worker *> busy;
+
+	pool->Lock();
+	for (std::deque<Task *>::iterator it = pool->pending.begin(); it != pool->pending.end();)
+	{
+		Task *t = *it;
+		if (t->owner == m)
+		{
+			it = pool->pending.erase(it);
+			delete t;
+		}
+		else
+			++it;
+	}
+	for (unsigned i = 0; i < pool->workers.size(); ++i)
+		if (pool->workers[i]->current && pool->workers[i]->current->owner == m)
+			busy.push_back(pool->workers[i]);
+	pool->Unlock();
+
+	/* The module's code may still be running, wait for it to finish */
+	for (unsigned i = 0; i < busy.size(); ++i)
+	{
+		busy[i]->running.Lock();
+		busy[i]->running.Unlock();
+	}
+
+	pool->Lock();
+	for (std::deque<Task *>::iterator it = pool->finished.begin(); it != pool->finished.end();)
+	{
+		Task *t = *it;
+		if (t->owner == m)
+		{
+			it = pool->finished.erase(it);
+			delete t;
+		}
+		else
+			++it;
+	}
+	pool->Unlock();
+}
+
+void WorkerPool::Shutdown()
+{
+	delete pool;
+	pool = NULL;
+}
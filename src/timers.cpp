@@ -9,7 +9,9 @@
 #include "services.h"
 #include "timers.h"
 
-std::multimap<time_t, Timer *> TimerManager::Timers;
+std::list<Timer *> TimerManager::Wheel[TimerManager::Levels][TimerManager::Slots];
+unsigned TimerManager::Counts[TimerManager::Levels];
+uint64_t TimerManager::WheelTime = 0;
 
 Timer::Timer(long time_from_now, time_t now, bool repeating)
 {
@@ -18,6 +20,9 @@ Timer::Timer(long time_from_now, time_t now, bool repeating)
 	secs = time_from_now;
 	repeat = repeating;
 	settime = now;
+	deadline = 0;
+	level = -1;
+	slot = 0;
 
 	TimerManager::AddTimer(this);
 }
@@ -29,6 +34,9 @@ Timer::Timer(Module *creator, long time_from_now, time_t now, bool repeating)
 	secs = time_from_now;
 	repeat = repeating;
 	settime = now;
+	deadline = 0;
+	level = -1;
+	slot = 0;
 
 	TimerManager::AddTimer(this);
 }
@@ -78,49 +86,159 @@ Module *Timer::GetOwner() const
 	return owner;
 }
 
-void TimerManager::AddTimer(Timer *t)
+uint64_t TimerManager::GetTime()
 {
-	Timers.insert(std::make_pair(t->GetTimer(), t));
+#ifdef _WIN32
+	return GetTickCount64();
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#endif
 }
 
-void TimerManager::DelTimer(Timer *t)
+void TimerManager::Schedule(Timer *t)
+{
+	uint64_t deadline = std::max(t->deadline, WheelTime);
+	int level = 0;
+
+	/* Find the lowest level whose current slot covers the deadline. Timers due
+	 * after the wheel's span are parked in its last slot and rescheduled later.
+	 */
+	while (level < Levels - 1 && (deadline >> (SlotBits * (level + 1))) != (WheelTime >> (SlotBits * (level + 1))))
+		++level;
+	if (level == Levels - 1 && (deadline >> (SlotBits * Levels)) != (WheelTime >> (SlotBits * Levels)))
+		deadline = ((WheelTime >> (SlotBits * Levels)) + 1) << (SlotBits * Levels);
+
+	std::list<Timer *> &bucket = Wheel[level][(deadline >> (SlotBits * level)) & (Slots - 1)];
+	t->pos = bucket.insert(bucket.end(), t);
+	t->level = level;
+	t->slot = (deadline >> (SlotBits * level)) & (Slots - 1);
+	++Counts[level];
+}
+
+void TimerManager::Cascade(int level)
 {
-	std::pair<std::multimap<time_t, Timer *>::iterator, std::multimap<time_t, Timer *>::iterator> itpair = Timers.equal_range(t->GetTimer());
-	for (std::multimap<time_t, Timer *>::iterator i = itpair.first; i != itpair.second; ++i)
+	std::list<Timer *> bucket;
+	bucket.swap(Wheel[level][(WheelTime >> (SlotBits * level)) & (Slots - 1)]);
+	Counts[level] -= bucket.size();
+
+	for (std::list<Timer *>::iterator it = bucket.begin(), it_end = bucket.end(); it != it_end; ++it)
+		Schedule(*it);
+}
+
+long TimerManager::GetTimeout(long max)
+{
+	uint64_t now = GetTime(), next = 0;
+
+	/* Level 0 only holds timers due before the end of its current rotation, and
+	 * the timers on higher levels can't be due before the next slot of their level.
+	 */
+	for (int level = 0; level < Levels && !next; ++level)
 	{
-		if (i->second == t)
+		if (!Counts[level])
+			continue;
+
+		if (level == 0)
 		{
-			Timers.erase(i);
-			break;
+			for (uint64_t ms = WheelTime; (ms >> SlotBits) == (WheelTime >> SlotBits); ++ms)
+				if (!Wheel[0][ms & (Slots - 1)].empty())
+				{
+					next = ms;
+					break;
+				}
 		}
+		else
+			next = ((WheelTime >> (SlotBits * level)) + 1) << (SlotBits * level);
 	}
+
+	if (!next)
+		return max;
+	if (next <= now)
+		return 0;
+	return std::min(static_cast<uint64_t>(max), next - now);
+}
+
+void TimerManager::AddTimer(Timer *t)
+{
+	if (t->level != -1)
+		DelTimer(t);
+
+	uint64_t now = GetTime();
+	if (!WheelTime)
+		WheelTime = now;
+
+	time_t secs = t->GetTimer() - Anope::CurTime;
+	t->deadline = now + (secs > 0 ? static_cast<uint64_t>(secs) * 1000 : 0);
+	Schedule(t);
+}
+
+void TimerManager::DelTimer(Timer *t)
+{
+	if (t->level == -1)
+		return;
+
+	Wheel[t->level][t->slot].erase(t->pos);
+	--Counts[t->level];
+	t->level = -1;
 }
 
 void TimerManager::TickTimers(time_t ctime)
 {
-	while (!Timers.empty())
+	uint64_t now = GetTime();
+
+	while (WheelTime <= now)
 	{
-		std::multimap<time_t, Timer *>::iterator it = Timers.begin();
-		Timer *t = it->second;
+		for (int level = Levels - 1; level > 0; --level)
+			if (!(WheelTime & ((static_cast<uint64_t>(1) << (SlotBits * level)) - 1)))
+				Cascade(level);
+
+		/* Skip ahead to the next time something could be due */
+		int lowest = 0;
+		while (lowest < Levels && !Counts[lowest])
+			++lowest;
 
-		if (t->GetTimer() > ctime)
+		if (lowest == Levels)
+		{
+			WheelTime = now + 1;
 			break;
+		}
+		else if (lowest > 0)
+		{
+			WheelTime = std::min(((WheelTime >> (SlotBits * lowest)) + 1) << (SlotBits * lowest), now + 1);
+			continue;
+		}
 
-		t->Tick(ctime);
+		/* Advance first, so timers added while ticking are never placed in the slot being ticked */
+		std::list<Timer *> &bucket = Wheel[0][WheelTime & (Slots - 1)];
+		++WheelTime;
 
-		if (t->GetRepeat())
-			t->SetTimer(ctime + t->GetSecs());
-		else
-			delete t;
+		while (!bucket.empty())
+		{
+			Timer *t = bucket.front();
+			DelTimer(t);
+
+			t->Tick(ctime);
+
+			if (t->GetRepeat())
+				t->SetTimer(ctime + t->GetSecs());
+			else
+				delete t;
+		}
 	}
 }
 
 void TimerManager::DeleteTimersFor(Module *m)
 {
-	for (std::multimap<time_t, Timer *>::iterator it = Timers.begin(), it_next = it; it != Timers.end(); it = it_next)
-	{
-		++it_next;
-		if (it->second->GetOwner() == m)
-			delete it->second;
-	}
+	for (int level = 0; level < Levels; ++level)
+		for (int slot = 0; slot < Slots; ++slot)
+		{
+			std::list<Timer *> &bucket = Wheel[level][slot];
+			for (std::list<Timer *>::iterator it = bucket.begin(), it_next = it; it != bucket.end(); it = it_next)
+			{
+				++it_next;
+				if ((*it)->GetOwner() == m)
+					delete *it;
+			}
+		}
 }
@@ -0,0 +1,88 @@
+/* Benchmark of case insensitive hash map lookups.
+ *
+ * (C) 2003-2024 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ *
+ * Fills an Anope::hash_map style map with nick-like keys and looks them up
+ * with their case changed, half of the lookups missing. It is run once with
+ * the hash and compare functors Anope used to use, which lowercased a copy of
+ * each key, and once with the current Anope::hash_ci and Anope::compare.
+ */
+
+#include "services.h"
+#include "anope.h"
+
+#include <ctime>
+
+namespace
+{
+	/* How Anope::hash_ci and Anope::compare used to work */
+	struct copying_hash_ci
+	{
+		size_t operator()(const Anope::string &s) const
+		{
+			return TR1NS::hash<std::string>()(s.lower().str());
+		}
+	};
+
+	struct copying_compare
+	{
+		bool operator()(const Anope::string &s1, const Anope::string &s2) const
+		{
+			return s1.equals_ci(s2);
+		}
+	};
+
+	const unsigned NumKeys = 50000;
+	const unsigned NumLookups = 2000000;
+
+	Anope::string MakeKey(unsigned i)
+	{
+		static const char *prefixes[] = { "Guest", "nick", "Someone_", "[away]", "x" };
+		return Anope::string(prefixes[i % 5]) + stringify(i * 7919 % 1000003);
+	}
+
+	/* Swaps the case of every other letter, so lookups never match the stored key exactly */
+	Anope::string SwapCase(const Anope::string &s)
+	{
+		Anope::string r = s;
+		for (unsigned i = 0; i < r.length(); i += 2)
+			r[i] = isupper(static_cast<unsigned char>(r[i])) ? tolower(r[i]) : toupper(r[i]);
+		return r;
+	}
+
+	template<typename Hash, typename Compare>
+	void Run(const char *name, const std::vector<Anope::string> &keys, const std::vector<Anope::string> &lookups)
+	{
+		TR1NS::unordered_map<Anope::string, unsigned, Hash, Compare> map;
+		for (unsigned i = 0; i < keys.size(); ++i)
+			map[keys[i]] = i;
+
+		unsigned found = 0;
+		std::clock_t start = std::clock();
+		for (unsigned i = 0; i < lookups.size(); ++i)
+			if (map.find(lookups[i]) != map.end())
+				++found;
+		double secs = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+
+		std::printf("%-8s %u lookups (%u found) in %.3fs, %.2f million lookups/s\n", name, static_cast<unsigned>(lookups.size()), found, secs, secs > 0 ? lookups.size() / secs / 1000000 : 0);
+	}
+}
+
+int main()
+{
+	Anope::CaseMapRebuild();
+
+	std::vector<Anope::string> keys, lookups;
+	for (unsigned i = 0; i < NumKeys; ++i)
+		keys.push_back(MakeKey(i));
+	for (unsigned i = 0; i < NumLookups; ++i)
+		lookups.push_back(SwapCase(i % 2 ? keys[i % NumKeys] : MakeKey(NumKeys + i % NumKeys)));
+
+	Run<copying_hash_ci, copying_compare>("before", keys, lookups);
+	Run<Anope::hash_ci, Anope::compare>("after", keys, lookups);
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+/* Benchmark of Reference tracking.
+ *
+ * (C) 2003-2024 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ *
+ * Measures creating, copying and destroying References to an object, and
+ * destroying objects which have many live References. Both are run once with
+ * a copy of the way Base used to track its references, in a std::set it
+ * allocated on first use, and once with the current Base and Reference.
+ */
+
+#include "services.h"
+#include "anope.h"
+#include "base.h"
+
+#include <ctime>
+
+namespace
+{
+	/* How Base and Reference used to work */
+	class SetReferenceBase
+	{
+	 protected:
+		bool invalid;
+	 public:
+		SetReferenceBase() : invalid(false) { }
+		SetReferenceBase(const SetReferenceBase &other) : invalid(other.invalid) { }
+		virtual ~SetReferenceBase() { }
+		void Invalidate() { this->invalid = true; }
+	};
+
+	class SetBase
+	{
+		std::set<SetReferenceBase *> *references;
+	 public:
+		SetBase() : references(NULL) { }
+
+		virtual ~SetBase()
+		{
+			if (this->references != NULL)
+			{
+				for (std::set<SetReferenceBase *>::iterator it = this->references->begin(), it_end = this->references->end(); it != it_end; ++it)
+					(*it)->Invalidate();
+				delete this->references;
+			}
+		}
+
+		void AddReference(SetReferenceBase *r)
+		{
+			if (this->references == NULL)
+				this->references = new std::set<SetReferenceBase *>();
+			this->references->insert(r);
+		}
+
+		void DelReference(SetReferenceBase *r)
+		{
+			if (this->references != NULL)
+			{
+				this->references->erase(r);
+				if (this->references->empty())
+				{
+					delete this->references;
+					this->references = NULL;
+				}
+			}
+		}
+	};
+
+	template<typename T>
+	class SetReference : public SetReferenceBase
+	{
+		T *ref;
+	 public:
+		SetReference(T *obj) : ref(obj)
+		{
+			if (ref)
+				ref->AddReference(this);
+		}
+
+		SetReference(const SetReference<T> &other) : SetReferenceBase(other), ref(other.ref)
+		{
+			if (operator bool())
+				ref->AddReference(this);
+		}
+
+		virtual ~SetReference()
+		{
+			if (operator bool())
+				ref->DelReference(this);
+		}
+
+		virtual operator bool()
+		{
+			return !this->invalid && this->ref != NULL;
+		}
+
+		T *operator->()
+		{
+			return operator bool() ? this->ref : NULL;
+		}
+	};
+
+	struct SetObject : SetBase
+	{
+		int value;
+		SetObject() : value(1) { }
+	};
+
+	struct Object : Base
+	{
+		int value;
+		Object() : value(1) { }
+	};
+
+	const unsigned NumChurn = 10000000;
+	const unsigned NumObjects = 2000;
+	const unsigned NumLiveReferences = 1000;
+
+	double Elapsed(std::clock_t start)
+	{
+		return static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+	}
+
+	/* References are made and dropped while another is held, like a command holding its source */
+	template<typename O, typename R>
+	void Churn(const char *name)
+	{
+		O obj;
+		R held(&obj);
+		unsigned sum = 0;
+
+		std::clock_t start = std::clock();
+		for (unsigned i = 0; i < NumChurn; ++i)
+		{
+			R r(&obj);
+			R copy(r);
+			sum += copy->value;
+		}
+		double secs = Elapsed(start);
+
+		std::printf("%-8s churn: %u references in %.3fs, %.1f ns per reference (%u)\n", name, 2 * NumChurn, secs, secs * 1e9 / (2.0 * NumChurn), sum);
+	}
+
+	/* Objects are destroyed while many references to them are still live */
+	template<typename O, typename R>
+	void Destroy(const char *name)
+	{
+		std::vector<R> refs;
+		refs.reserve(NumLiveReferences);
+		unsigned valid = 0;
+
+		std::clock_t start = std::clock();
+		for (unsigned i = 0; i < NumObjects; ++i)
+		{
+			O *obj = new O();
+			for (unsigned j = 0; j < NumLiveReferences; ++j)
+				refs.push_back(R(obj));
+			delete obj;
+			for (unsigned j = 0; j < NumLiveReferences; ++j)
+				if (refs[j])
+					++valid;
+			refs.clear();
+		}
+		double secs = Elapsed(start);
+
+		std::printf("%-8s destroy: %u objects with %u live references in %.3fs, %.1f us per object (%u left valid)\n", name, NumObjects, NumLiveReferences, secs, secs * 1e6 / NumObjects, valid);
+	}
+}
+
+int main()
+{
+	Churn<SetObject, SetReference<SetObject> >("before");
+	Churn<Object, Reference<Object> >("after");
+
+	Destroy<SetObject, SetReference<SetObject> >("before");
+	Destroy<Object, Reference<Object> >("after");
+
+	return 0;
+}
@@ -24,12 +24,21 @@
 #include "uplink.h"
 
 user_map UserListByNick, UserListByUID;
+user_index UserIndexByNick;
 
 int OperCount = 0;
 unsigned MaxUserCount = 0;
 time_t MaxUserTime = 0;
 
 std::list<User *> User::quitting_users;
+/* The last access generation given to a user */
+static uint64_t AccessGeneration = 0;
+
+/* Modes without parameters are kept in flag_modes instead of the mode map */
+static inline bool IsFlagMode(const UserMode *um)
+{
+	return um->type == MODE_REGULAR && um->mchar;
+}
 
 User::User(const Anope::string &snick, const Anope::string &sident, const Anope::string &shost, const Anope::string &svhost, const Anope::string &uip, Server *sserver, const Anope::string &srealname, time_t ts, const Anope::string &smodes, const Anope::string &suid, NickCore *account) : ip(uip)
 {
@@ -54,9 +63,11 @@ User::User(const Anope::string &snick, const Anope::string &sident, const Anope:
 	this->uid = suid;
 	this->super_admin = false;
 	this->nc = NULL;
+	this->access_generation = ++AccessGeneration;
 
 	size_t old = UserListByNick.size();
 	UserListByNick[snick] = this;
+	UserIndexByNick[snick] = this;
 	if (!suid.empty())
 		UserListByUID[suid] = this;
 	if (old == UserListByNick.size())
@@ -147,6 +158,7 @@ void User::ChangeNick(const Anope::string &newnick, time_t ts)
 
 	Anope::string old = this->nick;
 	this->timestamp = ts;
+	this->access_generation = ++AccessGeneration;
 
 	if (this->nick.equals_ci(newnick))
 		this->nick = newnick;
@@ -157,6 +169,7 @@ void User::ChangeNick(const Anope::string &newnick, time_t ts)
 			old_na->last_seen = Anope::CurTime;
 
 		UserListByNick.erase(this->nick);
+		UserIndexByNick.erase(this->nick);
 
 		this->nick = newnick;
 
@@ -168,6 +181,7 @@ void User::ChangeNick(const Anope::string &newnick, time_t ts)
 			return;
 		}
 		other = this;
+		UserIndexByNick[this->nick] = this;
 
 		on_access = false;
 		NickAlias *na = NickAlias::Find(this->nick);
@@ -311,6 +325,7 @@ User::~User()
 		this->chans.begin()->second->chan->DeleteUser(this);
 
 	UserListByNick.erase(this->nick);
+	UserIndexByNick.erase(this->nick);
 	if (!this->uid.empty())
 		UserListByUID.erase(this->uid);
 
@@ -375,7 +390,7 @@ void User::Identify(NickAlias *na)
 			this->SetModes(NULL, "%s", this->nc->o->ot->modes.c_str());
 			this->SendMessage(NULL, "Changing your usermodes to \002%s\002", this->nc->o->ot->modes.c_str());
 			UserMode *um = ModeManager::FindUserModeByName("OPER");
-			if (um && !this->HasMode("OPER") && this->nc->o->ot->modes.find(um->mchar) != Anope::string::npos)
+			if (um && !this->HasMode(um) && this->nc->o->ot->modes.find(um->mchar) != Anope::string::npos)
 				IRCD->SendOper(this);
 		}
 		if (IRCD->CanSetVHost && !this->nc->o->vhost.empty())
@@ -417,6 +432,12 @@ void User::Logout()
 		this->nc->users.erase(it);
 
 	this->nc = NULL;
+	this->access_generation = ++AccessGeneration;
+}
+
+uint64_t User::GetAccessGeneration() const
+{
+	return this->access_generation;
 }
 
 NickCore *User::Account() const
@@ -500,6 +521,9 @@ bool User::HasPriv(const Anope::string &priv)
 
 void User::UpdateHost()
 {
+	/* Everything which changes the user's mask or account comes through here */
+	this->access_generation = ++AccessGeneration;
+
 	if (this->host.empty())
 		return;
 
@@ -521,15 +545,30 @@ void User::UpdateHost()
 
 bool User::HasMode(const Anope::string &mname) const
 {
+	UserMode *um = ModeManager::FindUserModeByName(mname);
+	if (um)
+		return this->HasMode(um);
 	return this->modes.count(mname);
 }
 
+bool User::HasMode(UserMode *um) const
+{
+	if (!um)
+		return false;
+	if (IsFlagMode(um))
+		return this->flag_modes.test(static_cast<unsigned char>(um->mchar));
+	return this->modes.count(um->name);
+}
+
 void User::SetModeInternal(const MessageSource &source, UserMode *um, const Anope::string &param)
 {
 	if (!um)
 		return;
 
-	this->modes[um->name] = param;
+	if (IsFlagMode(um))
+		this->flag_modes.set(static_cast<unsigned char>(um->mchar));
+	else
+		this->modes[um->name] = param;
 
 	if (um->name == "OPER")
 	{
@@ -542,7 +581,7 @@ void User::SetModeInternal(const MessageSource &source, UserMode *um, const Anop
 				this->SetModes(NULL, "%s", this->nc->o->ot->modes.c_str());
 				this->SendMessage(NULL, "Changing your usermodes to \002%s\002", this->nc->o->ot->modes.c_str());
 				UserMode *oper = ModeManager::FindUserModeByName("OPER");
-				if (oper && !this->HasMode("OPER") && this->nc->o->ot->modes.find(oper->mchar) != Anope::string::npos)
+				if (oper && !this->HasMode(oper) && this->nc->o->ot->modes.find(oper->mchar) != Anope::string::npos)
 					IRCD->SendOper(this);
 			}
 			if (IRCD->CanSetVHost && !this->nc->o->vhost.empty())
@@ -565,7 +604,10 @@ void User::RemoveModeInternal(const MessageSource &source, UserMode *um)
 	if (!um)
 		return;
 
-	this->modes.erase(um->name);
+	if (IsFlagMode(um))
+		this->flag_modes.reset(static_cast<unsigned char>(um->mchar));
+	else
+		this->modes.erase(um->name);
 
 	if (um->name == "OPER")
 	{
@@ -586,7 +628,7 @@ void User::RemoveModeInternal(const MessageSource &source, UserMode *um)
 
 void User::SetMode(BotInfo *bi, UserMode *um, const Anope::string &param)
 {
-	if (!um || HasMode(um->name))
+	if (!um || HasMode(um))
 		return;
 
 	ModeManager::StackerAdd(bi, this, um, true, param);
@@ -600,7 +642,7 @@ void User::SetMode(BotInfo *bi, const Anope::string &uname, const Anope::string
 
 void User::RemoveMode(BotInfo *bi, UserMode *um, const Anope::string &param)
 {
-	if (!um || !HasMode(um->name))
+	if (!um || !HasMode(um))
 		return;
 
 	ModeManager::StackerAdd(bi, this, um, false, param);
@@ -707,6 +749,16 @@ Anope::string User::GetModes() const
 {
 	Anope::string m, params;
 
+	for (unsigned i = 0; i < this->flag_modes.size(); ++i)
+	{
+		if (!this->flag_modes.test(i))
+			continue;
+
+		UserMode *um = ModeManager::FindUserModeByChar(i);
+		if (um && IsFlagMode(um))
+			m += um->mchar;
+	}
+
 	for (ModeList::const_iterator it = this->modes.begin(), it_end = this->modes.end(); it != it_end; ++it)
 	{
 		UserMode *um = ModeManager::FindUserModeByName(it->first);
@@ -722,9 +774,21 @@ Anope::string User::GetModes() const
 	return m + params;
 }
 
-const User::ModeList &User::GetModeList() const
+User::ModeList User::GetModeList() const
 {
-	return modes;
+	ModeList m = this->modes;
+
+	for (unsigned i = 0; i < this->flag_modes.size(); ++i)
+	{
+		if (!this->flag_modes.test(i))
+			continue;
+
+		UserMode *um = ModeManager::FindUserModeByChar(i);
+		if (um && IsFlagMode(um))
+			m[um->name] = "";
+	}
+
+	return m;
 }
 
 ChanUserContainer *User::FindChannel(Channel *c) const
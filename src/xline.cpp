@@ -19,6 +19,308 @@
 #include "commands.h"
 #include "servers.h"
 
+/* Index of the hosts of the XLines in an XLineManager. Hosts without wildcards are kept
+ * in a hash map, CIDR ranges in a trie of their address bits, and hosts with wildcards in
+ * a trie of the literal text after their last wildcard (or before their first). Only the
+ * XLines which can't be indexed, such as regexes and hosts which begin and end with a
+ * wildcard, are checked against every user.
+ */
+class XLineIndex
+{
+	struct Node
+	{
+		std::map<char, Node *> children;
+		std::vector<XLine *> xlines;
+
+		~Node()
+		{
+			Clear(this);
+		}
+	};
+
+	enum IndexType
+	{
+		INDEX_NONE,
+		INDEX_EXACT,
+		INDEX_PREFIX,
+		INDEX_SUFFIX
+	};
+
+	struct Entry
+	{
+		/* Used to check candidates in the same order as the XLineManager's list */
+		unsigned long seq;
+		IndexType type;
+		Anope::string key;
+		/* Address bits of the CIDR range, if any */
+		Anope::string range;
+	};
+
+	std::map<XLine *, Entry> entries;
+	Anope::hash_map<std::vector<XLine *> > exact;
+	Node prefixes, suffixes, ranges;
+	std::vector<XLine *> unindexed;
+	unsigned long seq;
+
+	static Anope::string Fold(const Anope::string &str, bool reverse)
+	{
+		Anope::string folded;
+		for (unsigned i = 0; i < str.length(); ++i)
+			folded += Anope::tolower(str[reverse ? str.length() - i - 1 : i]);
+		return folded;
+	}
+
+	static Anope::string AddressBits(const sockaddrs &addr, unsigned len)
+	{
+		const unsigned char *ip;
+		unsigned max;
+
+		switch (addr.family())
+		{
+			case AF_INET:
+				ip = reinterpret_cast<const unsigned char *>(&addr.sa4.sin_addr);
+				max = 32;
+				break;
+			case AF_INET6:
+				ip = reinterpret_cast<const unsigned char *>(&addr.sa6.sin6_addr);
+				max = 128;
+				break;
+			default:
+				return "";
+		}
+
+		/* Keep IPv4 and IPv6 ranges apart */
+		Anope::string bits = max == 32 ? "4" : "6";
+		for (unsigned i = 0; i < len && i < max; ++i)
+			bits += (ip[i / 8] & (0x80 >> (i % 8))) ? '1' : '0';
+		return bits;
+	}
+
+	static void Clear(Node *node)
+	{
+		for (std::map<char, Node *>::iterator it = node->children.begin(), it_end = node->children.end(); it != it_end; ++it)
+			delete it->second;
+		node->children.clear();
+		node->xlines.clear();
+	}
+
+	static void Insert(Node *node, const Anope::string &key, XLine *x)
+	{
+		for (unsigned i = 0; i < key.length(); ++i)
+		{
+			Node *&child = node->children[key[i]];
+			if (child == NULL)
+				child = new Node();
+			node = child;
+		}
+
+		node->xlines.push_back(x);
+	}
+
+	static void Remove(Node *node, const Anope::string &key, XLine *x)
+	{
+		std::vector<Node *> path;
+		path.push_back(node);
+
+		for (unsigned i = 0; i < key.length(); ++i)
+		{
+			std::map<char, Node *>::iterator it = node->children.find(key[i]);
+			if (it == node->children.end())
+				return;
+			node = it->second;
+			path.push_back(node);
+		}
+
+		std::vector<XLine *>::iterator it = std::find(node->xlines.begin(), node->xlines.end(), x);
+		if (it != node->xlines.end())
+			node->xlines.erase(it);
+
+		/* Prune nodes which no longer lead anywhere */
+		for (unsigned i = key.length(); i > 0; --i)
+		{
+			Node *n = path[i];
+			if (!n->xlines.empty() || !n->children.empty())
+				break;
+
+			path[i - 1]->children.erase(key[i - 1]);
+			delete n;
+		}
+	}
+
+	static void Find(const Node *node, const Anope::string &key, std::vector<XLine *> &found)
+	{
+		for (unsigned i = 0; i < key.length(); ++i)
+		{
+			std::map<char, Node *>::const_iterator it = node->children.find(key[i]);
+			if (it == node->children.end())
+				return;
+			node = it->second;
+			found.insert(found.end(), node->xlines.begin(), node->xlines.end());
+		}
+	}
+
+	void FindHost(const Anope::string &host, std::vector<XLine *> &found) const
+	{
+		if (host.empty())
+			return;
+
+		Anope::hash_map<std::vector<XLine *> >::const_iterator it = this->exact.find(host);
+		if (it != this->exact.end())
+			found.insert(found.end(), it->second.begin(), it->second.end());
+
+		Find(&this->prefixes, Fold(host, false), found);
+		Find(&this->suffixes, Fold(host, true), found);
+	}
+
+ public:
+	/* The earliest time an indexed XLine expires, or 0 */
+	time_t expiry;
+
+	XLineIndex() : seq(0), expiry(0) { }
+
+	void Add(XLine *x)
+	{
+		Entry &e = this->entries[x];
+		e.seq = this->seq++;
+		e.type = INDEX_NONE;
+
+		const Anope::string &host = x->GetHost();
+		size_t first = host.find_first_of("*?"), last = host.find_last_of("*?");
+
+		if (x->regex || host.empty())
+			;
+		else if (first == Anope::string::npos)
+		{
+			e.type = INDEX_EXACT;
+			e.key = host;
+		}
+		else if (last + 1 < host.length())
+		{
+			e.type = INDEX_SUFFIX;
+			e.key = Fold(host.substr(last + 1), true);
+		}
+		else if (first > 0)
+		{
+			e.type = INDEX_PREFIX;
+			e.key = Fold(host.substr(0, first), false);
+		}
+
+		switch (e.type)
+		{
+			case INDEX_EXACT:
+				this->exact[e.key].push_back(x);
+				break;
+			case INDEX_PREFIX:
+				Insert(&this->prefixes, e.key, x);
+				break;
+			case INDEX_SUFFIX:
+				Insert(&this->suffixes, e.key, x);
+				break;
+			default:
+				this->unindexed.push_back(x);
+		}
+
+		if (x->c && !x->regex)
+		{
+			/* cidr has no accessors for its address and length, so get them from its mask */
+			Anope::string mask = x->c->mask();
+			size_t sl = mask.find('/');
+			sockaddrs addr(mask.substr(0, sl));
+			unsigned len = sl != Anope::string::npos ? convertTo<unsigned>(mask.substr(sl + 1)) : 128;
+
+			e.range = AddressBits(addr, len);
+			if (!e.range.empty())
+				Insert(&this->ranges, e.range, x);
+		}
+
+		if (x->expires && (!this->expiry || x->expires < this->expiry))
+			this->expiry = x->expires;
+	}
+
+	void Remove(XLine *x)
+	{
+		std::map<XLine *, Entry>::iterator it = this->entries.find(x);
+		if (it == this->entries.end())
+			return;
+
+		const Entry &e = it->second;
+		switch (e.type)
+		{
+			case INDEX_EXACT:
+			{
+				Anope::hash_map<std::vector<XLine *> >::iterator it2 = this->exact.find(e.key);
+				if (it2 != this->exact.end())
+				{
+					std::vector<XLine *>::iterator it3 = std::find(it2->second.begin(), it2->second.end(), x);
+					if (it3 != it2->second.end())
+						it2->second.erase(it3);
+					if (it2->second.empty())
+						this->exact.erase(it2);
+				}
+				break;
+			}
+			case INDEX_PREFIX:
+				Remove(&this->prefixes, e.key, x);
+				break;
+			case INDEX_SUFFIX:
+				Remove(&this->suffixes, e.key, x);
+				break;
+			default:
+			{
+				std::vector<XLine *>::iterator it2 = std::find(this->unindexed.begin(), this->unindexed.end(), x);
+				if (it2 != this->unindexed.end())
+					this->unindexed.erase(it2);
+			}
+		}
+
+		if (!e.range.empty())
+			Remove(&this->ranges, e.range, x);
+
+		this->entries.erase(it);
+	}
+
+	void Clear()
+	{
+		this->entries.clear();
+		this->exact.clear();
+		this->unindexed.clear();
+
+		Clear(&this->prefixes);
+		Clear(&this->suffixes);
+		Clear(&this->ranges);
+		this->expiry = 0;
+	}
+
+	/** Find the XLines a user could match
+	 * @param u The user
+	 * @param candidates Filled with the XLines, most recently added first
+	 */
+	void Find(User *u, std::vector<XLine *> &candidates) const
+	{
+		std::vector<XLine *> found = this->unindexed;
+
+		this->FindHost(u->host, found);
+		if (u->ip.valid())
+		{
+			Anope::string ip = u->ip.addr();
+			if (ip != u->host)
+				this->FindHost(ip, found);
+			Find(&this->ranges, AddressBits(u->ip, 128), found);
+		}
+
+		std::map<unsigned long, XLine *> ordered;
+		for (unsigned i = 0; i < found.size(); ++i)
+		{
+			std::map<XLine *, Entry>::const_iterator it = this->entries.find(found[i]);
+			if (it != this->entries.end())
+				ordered[it->second.seq] = found[i];
+		}
+
+		for (std::map<unsigned long, XLine *>::reverse_iterator it = ordered.rbegin(), it_end = ordered.rend(); it != it_end; ++it)
+			candidates.push_back(it->second);
+	}
+};
+
 /* List of XLine managers we check users against in XLineManager::CheckAll */
 std::list<XLineManager *> XLineManager::XLineManagers;
 Serialize::Checker<std::multimap<Anope::string, XLine *, ci::less> > XLineManager::XLinesByUID("XLine");
@@ -261,13 +563,14 @@ Anope::string XLineManager::GenerateUID()
 	return id;
 }
 
-XLineManager::XLineManager(Module *creator, const Anope::string &xname, char t) : Service(creator, "XLineManager", xname), type(t), xlines("XLine")
+XLineManager::XLineManager(Module *creator, const Anope::string &xname, char t) : Service(creator, "XLineManager", xname), type(t), xlines("XLine"), host_index(new XLineIndex())
 {
 }
 
 XLineManager::~XLineManager()
 {
 	this->Clear();
+	delete this->host_index;
 }
 
 const char &XLineManager::Type()
@@ -290,6 +593,7 @@ void XLineManager::AddXLine(XLine *x)
 	if (!x->id.empty())
 		XLinesByUID->insert(std::make_pair(x->id, x));
 	this->xlines->push_back(x);
+	this->host_index->Add(x);
 	x->manager = this;
 }
 
@@ -314,6 +618,7 @@ void XLineManager::RemoveXLine(XLine *x)
 	{
 		this->SendDel(x);
 		this->xlines->erase(it);
+		this->host_index->Remove(x);
 	}
 }
 
@@ -337,6 +642,7 @@ bool XLineManager::DelXLine(XLine *x)
 		this->SendDel(x);
 
 		x->manager = NULL; // Don't call remove
+		this->host_index->Remove(x);
 		delete x;
 		this->xlines->erase(it);
 
@@ -360,6 +666,7 @@ void XLineManager::Clear()
 {
 	std::vector<XLine *> xl;
 	this->xlines->swap(xl);
+	this->host_index->Clear();
 
 	for (unsigned i = 0; i < xl.size(); ++i)
 	{
@@ -443,6 +750,55 @@ XLine* XLineManager::HasEntry(const Anope::string &mask)
 
 XLine *XLineManager::CheckAllXLines(User *u)
 {
+	if (this->IsHostIndexed())
+	{
+		/* Expired xlines which the user can't match would otherwise never be checked, so expire them here */
+		if (this->host_index->expiry && this->host_index->expiry < Anope::CurTime)
+		{
+			time_t expiry = 0;
+
+			for (unsigned i = this->xlines->size(); i > 0; --i)
+			{
+				XLine *x = this->xlines->at(i - 1);
+
+				if (x->expires && x->expires < Anope::CurTime)
+				{
+					this->OnExpire(x);
+					this->DelXLine(x);
+				}
+				else if (x->expires && (!expiry || x->expires < expiry))
+					expiry = x->expires;
+			}
+
+			this->host_index->expiry = expiry;
+		}
+		else if (this->xlines->empty())
+			return NULL;
+
+		std::vector<XLine *> candidates;
+		this->host_index->Find(u, candidates);
+
+		for (unsigned i = 0; i < candidates.size(); ++i)
+		{
+			XLine *x = candidates[i];
+
+			if (x->expires && x->expires < Anope::CurTime)
+			{
+				this->OnExpire(x);
+				this->DelXLine(x);
+				continue;
+			}
+
+			if (this->Check(u, x))
+			{
+				this->OnMatch(u, x);
+				return x;
+			}
+		}
+
+		return NULL;
+	}
+
 	for (unsigned i = this->xlines->size(); i > 0; --i)
 	{
 		XLine *x = this->xlines->at(i - 1);
@@ -464,6 +820,11 @@ XLine *XLineManager::CheckAllXLines(User *u)
 	return NULL;
 }
 
+bool XLineManager::IsHostIndexed() const
+{
+	return false;
+}
+
 void XLineManager::OnExpire(const XLine *x)
 {
 }